@@ -0,0 +1,40 @@
+#include <iostream>
+
+#include "catalog.hpp"
+
+std::shared_ptr<const table_map_t> catalog_t::snapshot()
+{
+    return std::atomic_load(&current);
+}
+
+bool catalog_t::publish(const table_map_t& base, const table_map_t& changed)
+{
+    std::lock_guard<std::mutex> guard(publishing);
+    auto latest = std::atomic_load(&current);
+    std::shared_ptr<table_map_t> next;
+
+    for(auto& t : changed)
+    {
+        auto before = base.find(t.first);
+        if(before != base.end() && before->second == t.second)
+            continue;
+
+        auto now = latest->find(t.first);
+        bool unchanged = before == base.end() ? now == latest->end()
+                                              : now != latest->end() && now->second == before->second;
+        if(!unchanged)
+        {
+            std::cerr << "Table " << t.first << " was changed by another"
+                      << " statement while this one ran." << std::endl;
+            return false;
+        }
+
+        if(!next)
+            next = std::make_shared<table_map_t>(*latest);
+        (*next)[t.first] = t.second;
+    }
+
+    if(next)
+        std::atomic_store(&current, std::shared_ptr<const table_map_t>(next));
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef _CATALOG_H
+#define _CATALOG_H
+
+#include <memory>
+#include <mutex>
+
+#include "table.hpp"
+
+// The tables queries run against, so queries can run at the same
+// time as each other and statements that add tables.
+
+// The map of tables is never changed once published. Each statement
+// runs on a copy of the snapshot current when it started, and any tables
+// it added or replaced are published after it, in a new snapshot. Tables
+// aren't changed once published either, CREATE_INDEX and ANALYZE replace
+// them with a new version, so a running query keeps the version it
+// started with until it's done.
+struct catalog_t
+{
+    std::shared_ptr<const table_map_t> snapshot();
+
+    // Publishes the tables of changed that differ from base, the snapshot
+    // it was copied from. Fails, publishing nothing, if any of them were
+    // also changed by a statement published since.
+    bool publish(const table_map_t& base, const table_map_t& changed);
+
+    private:
+    std::shared_ptr<const table_map_t> current = std::make_shared<const table_map_t>();
+    std::mutex                         publishing;
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "columnar_output.hpp"
+#include "query_limits.hpp"
+
+// Reads up to output_batch_rows rows of view into columns,
+// returns the number read.
+static unsigned int read_batch(table_view& view, std::vector<std::vector<cell>>& columns)
+{
+    unsigned int width = columns.size();
+    if(width && columns[0].size() < output_batch_rows)
+        limits.charge((unsigned long long int)width * output_batch_rows * sizeof(cell));
+    for(auto& column : columns)
+        column.resize(output_batch_rows);
+
+    unsigned int rows = 0;
+    while(rows < output_batch_rows && !view.empty())
+    {
+        for(unsigned int i = 0; i < width; i++)
+            columns[i][rows] = view.access_column(i);
+        view.advance_row();
+        rows++;
+    }
+    return rows;
+}
+
+template<typename T>
+static void write_value(result_writer& out, T value)
+{
+    out.write((const char*)&value, sizeof(T));
+}
+
+// Just enough of FlatBuffers to write Arrow's messages. Objects are
+// laid out front to back, tables after their vtable, and the objects
+// a table refers to after it, as offsets can only point forward.
+// Offsets are written as 0 and patched once their target is written.
+struct flatbuffer
+{
+    struct field
+    {
+        unsigned int           id;
+        unsigned int           size;
+        unsigned long long int value;
+    };
+
+    std::vector<unsigned char> bytes;
+
+    void pad_to(unsigned int alignment)
+    {
+        while(bytes.size() % alignment)
+            bytes.push_back(0);
+    }
+
+    template<typename T>
+    size_t scalar(T value)
+    {
+        pad_to(sizeof(T));
+        size_t at = bytes.size();
+        bytes.resize(at + sizeof(T));
+        memcpy(&bytes[at], &value, sizeof(T));
+        return at;
+    }
+
+    void patch(size_t at, size_t target)
+    {
+        uint32_t offset = target - at;
+        memcpy(&bytes[at], &offset, sizeof(offset));
+    }
+
+    size_t string(const std::string& text)
+    {
+        size_t at = scalar<uint32_t>(text.size());
+        bytes.insert(bytes.end(), text.begin(), text.end());
+        bytes.push_back(0);
+        return at;
+    }
+
+    // Vector of offsets to tables, positions of the offsets in elements.
+    size_t table_vector(unsigned int count, std::vector<size_t>& elements)
+    {
+        size_t at = scalar<uint32_t>(count);
+        elements.clear();
+        for(unsigned int i = 0; i < count; i++)
+            elements.push_back(scalar<uint32_t>(0));
+        return at;
+    }
+
+    // Vector of structs made of 64 bit values, which must be 8 byte aligned.
+    size_t struct_vector(const std::vector<long long int>& values, unsigned int struct_values)
+    {
+        pad_to(4);
+        while((bytes.size() + 4) % 8)
+            bytes.push_back(0);
+        size_t at = scalar<uint32_t>(values.size() / struct_values);
+        for(auto value : values)
+            scalar<long long int>(value);
+        return at;
+    }
+
+    // Fields are laid out largest first after the vtable offset, with
+    // the table 8 byte aligned so they're aligned in the buffer too.
+    // Returns the table's position, and each field's in positions[id].
+    size_t table(std::vector<field> fields, std::vector<size_t>& positions)
+    {
+        std::stable_sort(fields.begin(), fields.end(),
+                         [](const field& a, const field& b) { return a.size > b.size; });
+
+        unsigned int slots = 0;
+        for(auto& f : fields)
+            slots = std::max(slots, f.id + 1);
+
+        std::vector<uint16_t> offsets(slots, 0);
+        unsigned int size = 4;
+        for(auto& f : fields)
+        {
+            size = (size + f.size - 1) / f.size * f.size;
+            offsets[f.id] = size;
+            size += f.size;
+        }
+
+        pad_to(2);
+        size_t vtable = bytes.size();
+        scalar<uint16_t>(4 + 2 * slots);
+        scalar<uint16_t>(size);
+        for(auto offset : offsets)
+            scalar<uint16_t>(offset);
+
+        pad_to(8);
+        size_t start = bytes.size();
+        bytes.resize(start + size, 0);
+        int32_t vtable_offset = start - vtable;
+        memcpy(&bytes[start], &vtable_offset, sizeof(vtable_offset));
+
+        positions.assign(slots, 0);
+        for(auto& f : fields)
+        {
+            positions[f.id] = start + offsets[f.id];
+            memcpy(&bytes[positions[f.id]], &f.value, f.size);
+        }
+        return start;
+    }
+};
+
+// Message.fbs and Schema.fbs
+enum arrow_ids
+{
+    METADATA_V5         = 4,
+    HEADER_SCHEMA       = 1,
+    HEADER_RECORD_BATCH = 3,
+    TYPE_INT            = 2,
+    TYPE_FLOATING_POINT = 3,
+    PRECISION_DOUBLE    = 2,
+};
+
+// Message { version, header_type, header, bodyLength }, returns
+// the position of the header offset.
+static size_t arrow_message(flatbuffer& fb, unsigned int header_type,
+                            unsigned long long int body_length)
+{
+    size_t root = fb.scalar<uint32_t>(0);
+    std::vector<size_t> message;
+    fb.patch(root, fb.table({ { 0, 2, METADATA_V5 },
+                              { 1, 1, header_type },
+                              { 2, 4, 0 },
+                              { 3, 8, body_length } }, message));
+    return message[2];
+}
+
+// Encapsulated message: continuation marker, metadata size,
+// metadata padded to 8 bytes, then the body.
+static void write_message(result_writer& out, flatbuffer& fb)
+{
+    fb.pad_to(8);
+    write_value<uint32_t>(out, 0xFFFFFFFF);
+    write_value<int32_t>(out, fb.bytes.size());
+    out.write((const char*)fb.bytes.data(), fb.bytes.size());
+}
+
+static void write_schema(table_view& view, result_writer& out)
+{
+    flatbuffer fb;
+    size_t header = arrow_message(fb, HEADER_SCHEMA, 0);
+
+    // Schema { endianness = Little, fields }
+    std::vector<size_t> schema, fields;
+    fb.patch(header, fb.table({ { 1, 4, 0 } }, schema));
+    fb.patch(schema[1], fb.table_vector(view.width(), fields));
+
+    for(unsigned int i = 0; i < view.width(); i++)
+    {
+        bool integer = view.column_types[i] == cell_type::INT;
+
+        // Field { name, nullable, type_type, type, children }
+        std::vector<size_t> field, type;
+        fb.patch(fields[i], fb.table({ { 0, 4, 0 },
+                                       { 1, 1, 0 },
+                                       { 2, 1, integer ? TYPE_INT : TYPE_FLOATING_POINT },
+                                       { 3, 4, 0 },
+                                       { 5, 4, 0 } }, field));
+        fb.patch(field[0], fb.string(view.column_names[i]));
+
+        // Int { bitWidth, is_signed } or FloatingPoint { precision }
+        if(integer)
+            fb.patch(field[3], fb.table({ { 0, 4, 64 }, { 1, 1, 1 } }, type));
+        else
+            fb.patch(field[3], fb.table({ { 0, 2, PRECISION_DOUBLE } }, type));
+
+        std::vector<size_t> children;
+        fb.patch(field[5], fb.table_vector(0, children));
+    }
+
+    write_message(out, fb);
+}
+
+// Each column has an empty validity bitmap, as nothing is null,
+// and it's values, which are a multiple of 8 bytes so stay aligned.
+static void write_record_batch(std::vector<std::vector<cell>>& columns,
+                               unsigned int rows, result_writer& out)
+{
+    unsigned long long int column_bytes = (unsigned long long int)rows * sizeof(cell);
+
+    std::vector<long long int> nodes, buffers;
+    for(unsigned int i = 0; i < columns.size(); i++)
+    {
+        nodes.push_back(rows);
+        nodes.push_back(0);
+
+        buffers.push_back(i * column_bytes);
+        buffers.push_back(0);
+        buffers.push_back(i * column_bytes);
+        buffers.push_back(column_bytes);
+    }
+
+    flatbuffer fb;
+    size_t header = arrow_message(fb, HEADER_RECORD_BATCH, columns.size() * column_bytes);
+
+    // RecordBatch { length, nodes, buffers }
+    std::vector<size_t> batch;
+    fb.patch(header, fb.table({ { 0, 8, rows }, { 1, 4, 0 }, { 2, 4, 0 } }, batch));
+    fb.patch(batch[1], fb.struct_vector(nodes, 2));
+    fb.patch(batch[2], fb.struct_vector(buffers, 2));
+
+    write_message(out, fb);
+    for(auto& column : columns)
+        out.write((const char*)column.data(), column_bytes);
+}
+
+unsigned long long int write_arrow(table_view& view, result_writer& out)
+{
+    write_schema(view, out);
+
+    std::vector<std::vector<cell>> columns(view.width());
+    unsigned long long int total = 0;
+    while(!view.empty())
+    {
+        unsigned int rows = read_batch(view, columns);
+        write_record_batch(columns, rows, out);
+        total += rows;
+    }
+
+    write_value<uint32_t>(out, 0xFFFFFFFF);
+    write_value<uint32_t>(out, 0);
+    return total;
+}
+
+unsigned long long int write_raw_columns(table_view& view, result_writer& out)
+{
+    out.write("CSQLCOL1", 8);
+    write_value<uint32_t>(out, view.width());
+    for(unsigned int i = 0; i < view.width(); i++)
+    {
+        write_value<uint8_t>(out, view.column_types[i] == cell_type::INT ? 0 : 1);
+        write_value<uint32_t>(out, view.column_names[i].size());
+        out.write(view.column_names[i]);
+    }
+
+    std::vector<std::vector<cell>> columns(view.width());
+    unsigned long long int total = 0;
+    while(!view.empty())
+    {
+        unsigned int rows = read_batch(view, columns);
+        write_value<unsigned long long int>(out, rows);
+        for(auto& column : columns)
+            out.write((const char*)column.data(), rows * sizeof(cell));
+        total += rows;
+    }
+
+    write_value<unsigned long long int>(out, 0);
+    return total;
+}
@@ -0,0 +1,26 @@
+#ifndef _COLUMNAR_OUTPUT_H
+#define _COLUMNAR_OUTPUT_H
+
+#include "result_writer.hpp"
+#include "table_views.hpp"
+
+// Binary columnar result formats, for --output arrow and --output raw.
+// Rows are gathered into batches of columns, which are written
+// as they are, rather than formatted as text.
+
+static const unsigned int output_batch_rows = 1 << 16;
+
+// Arrow IPC streaming format: a schema message, a record batch
+// message per batch and an end of stream marker. Integers are
+// signed 64 bit and floats doubles, neither nullable.
+unsigned long long int write_arrow(table_view& view, result_writer& out);
+
+// Raw native columns:
+//   "CSQLCOL1", u32 columns,
+//   per column u8 type (0 integer, 1 double), u32 name length, name,
+//   per batch u64 rows then each column's rows as 8 byte values,
+//   u64 0 after the last batch.
+// In the machine's byte order.
+unsigned long long int write_raw_columns(table_view& view, result_writer& out);
+
+#endif
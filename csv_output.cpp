@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <vector>
+
+#include "csv_output.hpp"
+#include "query_limits.hpp"
+#include "scheduler.hpp"
+#include "trace.hpp"
+
+struct csv_batch
+{
+    // Row major.
+    std::vector<cell> values;
+    unsigned int      rows = 0;
+
+    // Grown as rows are formatted, so there's always room for
+    // the longest a row could be. text_length is used.
+    std::vector<char> text;
+    size_t            text_length = 0;
+};
+
+static unsigned int read_batch(table_view& view, csv_batch& batch)
+{
+    unsigned int width = view.width();
+    size_t cells = (size_t)csv_batch_rows * width;
+    if(batch.values.size() < cells)
+        limits.charge((cells - batch.values.size()) * sizeof(cell));
+    batch.values.resize(cells);
+
+    cell* values = batch.values.data();
+    batch.rows = 0;
+    while(batch.rows < csv_batch_rows && !view.empty())
+    {
+        for(unsigned int i = 0; i < width; i++)
+            *values++ = view.access_column(i);
+        view.advance_row();
+        batch.rows++;
+    }
+    return batch.rows;
+}
+
+static void format_batch(csv_batch& batch, const std::vector<cell_type>& types)
+{
+    unsigned int width = types.size();
+    size_t row_bytes = (size_t)width * (result_writer::max_cell + 1);
+
+    const cell* value = batch.values.data();
+    size_t length = 0;
+    for(unsigned int row = 0; row < batch.rows; row++)
+    {
+        if(batch.text.size() - length < row_bytes)
+        {
+            auto grown = std::max(2 * batch.text.size(), length + row_bytes);
+            limits.charge(grown - batch.text.size());
+            batch.text.resize(grown);
+        }
+
+        char* start = batch.text.data();
+        char* out   = start + length;
+        for(unsigned int i = 0; i < width; i++, value++)
+        {
+            out = types[i] == cell_type::INT ? format_integer(value->i, out)
+                                             : format_double(value->d, out);
+            *out++ = i == width - 1 ? '\n' : ',';
+        }
+        length = out - start;
+    }
+    batch.text_length = length;
+}
+
+// Batches go through a ring of slots, by sequence number. The calling
+// thread reads batch read_seq into it's slot and submits formatting it,
+// then writes batch write_seq once it's task is done, running format
+// tasks itself while it waits.
+struct csv_pipeline
+{
+    table_view&            view;
+    result_writer&         out;
+    std::vector<cell_type> types;
+
+    std::vector<csv_batch>  slots;
+    std::vector<task_group> formatting;
+    unsigned long long int  read_seq  = 0;
+    unsigned long long int  write_seq = 0;
+
+    csv_pipeline(table_view& view_, result_writer& out_, unsigned int threads)
+        : view(view_), out(out_), types(view_.column_types),
+          slots(2 * threads), formatting(2 * threads) {}
+
+    // Tasks still format into our slots if reading throws.
+    ~csv_pipeline()
+    {
+        for(auto& group : formatting)
+        {
+            try { scheduler.wait(group); }
+            catch(...) {}
+        }
+    }
+
+    // The first batch was already read into slot 0.
+    unsigned long long int run(csv_batch& first)
+    {
+        std::swap(slots[0], first);
+        unsigned long long int rows = slots[0].rows;
+        publish();
+
+        while(!view.empty())
+        {
+            if(read_seq - write_seq == slots.size())
+                write();
+            rows += read_batch(view, slots[read_seq % slots.size()]);
+            publish();
+        }
+
+        while(write_seq < read_seq)
+            write();
+        return rows;
+    }
+
+    void publish()
+    {
+        auto* batch = &slots[read_seq % slots.size()];
+        auto* batch_types = &types;
+        scheduler.submit(formatting[read_seq % slots.size()], [batch, batch_types]
+        {
+            trace_span span("format csv");
+            format_batch(*batch, *batch_types);
+        });
+        read_seq++;
+    }
+
+    void write()
+    {
+        scheduler.wait(formatting[write_seq % slots.size()]);
+        auto& batch = slots[write_seq % slots.size()];
+        out.write(batch.text.data(), batch.text_length);
+        write_seq++;
+    }
+};
+
+unsigned long long int write_csv(table_view& view, result_writer& out)
+{
+    auto width = view.width();
+    for(unsigned int i = 0 ; i < width; i++)
+    {
+        out.write(view.column_names[i]);
+        if(i != width - 1) out.put(',');
+    }
+    out.put('\n');
+
+    csv_batch first;
+    read_batch(view, first);
+
+    if(view.empty() || scheduler.threads() < 2)
+    {
+        unsigned long long int rows = 0;
+        while(first.rows)
+        {
+            format_batch(first, view.column_types);
+            out.write(first.text.data(), first.text_length);
+            rows += first.rows;
+            read_batch(view, first);
+        }
+        return rows;
+    }
+
+    csv_pipeline pipeline(view, out, scheduler.threads());
+    return pipeline.run(first);
+}
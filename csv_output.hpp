@@ -0,0 +1,20 @@
+#ifndef _CSV_OUTPUT_H
+#define _CSV_OUTPUT_H
+
+#include "result_writer.hpp"
+#include "table_views.hpp"
+
+// CSV results, formatted in parallel.
+
+// The view is read on the calling thread a batch of rows at a time.
+// Batches are formatted into their own buffers by tasks on the
+// scheduler, and written out by the calling thread in the order
+// they were read. Results that fit in one batch are formatted and
+// written in place.
+
+static const unsigned int csv_batch_rows = 1 << 13;
+
+// Writes the header and rows of view, returns the rows written.
+unsigned long long int write_csv(table_view& view, result_writer& out);
+
+#endif
@@ -34,6 +34,7 @@ std::string output_token(token_t t)
 
         case token_t::SELECT:        stream << "SELECT";    break;
         case token_t::AS:            stream << "AS";        break;
+        case token_t::INTO:          stream << "INTO";      break;
         case token_t::FROM:          stream << "FROM";      break;
         case token_t::WHERE:         stream << "WHERE";     break;
         case token_t::LIMIT:         stream << "LIMIT";     break;
@@ -41,9 +42,16 @@ std::string output_token(token_t t)
 
         case token_t::SHOW:          stream << "SHOW";      break;
         case token_t::TABLES:        stream << "TABLES";    break;
+        case token_t::STATS:         stream << "STATS";     break;
 
         case token_t::DESCRIBE:      stream << "DESCRIBE";  break;
         case token_t::LOAD:          stream << "LOAD";      break;
+        case token_t::SORTED_BY:     stream << "SORTED_BY"; break;
+        case token_t::CREATE_INDEX:  stream << "CREATE_INDEX"; break;
+        case token_t::CREATE_TABLE:  stream << "CREATE_TABLE"; break;
+        case token_t::ANALYZE:       stream << "ANALYZE";   break;
+        case token_t::EXPLAIN:       stream << "EXPLAIN";   break;
+        case token_t::SET:           stream << "SET";       break;
         case token_t::EXIT:          stream << "EXIT";      break;
 
         case token_t::LEFT_JOIN:     stream << "LEFT";      break;
@@ -57,9 +65,14 @@ std::string output_token(token_t t)
         case token_t::OR:            stream << "OR";        break;
 
         case token_t::FUNCTION:      stream << "FUNCTION";  break;
+        case token_t::OVER:          stream << "OVER";      break;
+        case token_t::PARTITION_BY:  stream << "PARTITION_BY";  break;
+        case token_t::ORDER_BY:      stream << "ORDER_BY";  break;
+        case token_t::ROWS:          stream << "ROWS";      break;
 
         case token_t::SELECT_ALL:    stream << "SELECT_ALL";    break;
         case token_t::NEGATE:        stream << "NEGATE";        break;
+        case token_t::EXPLAIN_ANALYZE: stream << "EXPLAIN_ANALYZE"; break;
         case token_t::INVALID:       stream << "INVALID";       break;
     }
 
@@ -75,6 +88,8 @@ static token_t::token_type resolve_token_string(std::string token_string)
         return token_t::SELECT;
     if(token_string == "as" || token_string == "AS")
         return token_t::AS;
+    if(token_string == "into" || token_string == "INTO")
+        return token_t::INTO;
     if(token_string == "from" || token_string == "FROM")
         return token_t::FROM;
     if(token_string == "where" || token_string == "WHERE")
@@ -88,11 +103,25 @@ static token_t::token_type resolve_token_string(std::string token_string)
         return token_t::SHOW;
     if(token_string == "tables" || token_string == "TABLES")
         return token_t::TABLES;
+    if(token_string == "stats" || token_string == "STATS")
+        return token_t::STATS;
 
     if(token_string == "describe" || token_string == "DESCRIBE")
         return token_t::DESCRIBE;
     if(token_string == "load" || token_string == "LOAD")
         return token_t::LOAD;
+    if(token_string == "sorted_by" || token_string == "SORTED_BY")
+        return token_t::SORTED_BY;
+    if(token_string == "create_index" || token_string == "CREATE_INDEX")
+        return token_t::CREATE_INDEX;
+    if(token_string == "create_table" || token_string == "CREATE_TABLE")
+        return token_t::CREATE_TABLE;
+    if(token_string == "analyze" || token_string == "ANALYZE")
+        return token_t::ANALYZE;
+    if(token_string == "explain" || token_string == "EXPLAIN")
+        return token_t::EXPLAIN;
+    if(token_string == "set" || token_string == "SET")
+        return token_t::SET;
     if(token_string == "exit" || token_string == "EXIT")
         return token_t::EXIT;
 
@@ -111,6 +140,15 @@ static token_t::token_type resolve_token_string(std::string token_string)
     if(token_string == "on" || token_string == "ON")
         return token_t::ON;
 
+    if(token_string == "over" || token_string == "OVER")
+        return token_t::OVER;
+    if(token_string == "partition_by" || token_string == "PARTITION_BY")
+        return token_t::PARTITION_BY;
+    if(token_string == "order_by" || token_string == "ORDER_BY")
+        return token_t::ORDER_BY;
+    if(token_string == "rows" || token_string == "ROWS")
+        return token_t::ROWS;
+
     if(token_string == "and" || token_string == "AND")
         return token_t::AND;
     if(token_string == "or" || token_string == "OR")
@@ -121,7 +159,13 @@ static token_t::token_type resolve_token_string(std::string token_string)
     if(token_string == "max"     || token_string == "MAX"    ||
        token_string == "min"     || token_string == "MIN"    ||
        token_string == "median"  || token_string == "MEDIAN" ||
-       token_string == "average" || token_string == "AVERAGE")
+       token_string == "average" || token_string == "AVERAGE" ||
+       token_string == "sum"     || token_string == "SUM"    ||
+       token_string == "lag"     || token_string == "LAG"    ||
+       token_string == "lead"    || token_string == "LEAD"   ||
+       token_string == "first"   || token_string == "FIRST"  ||
+       token_string == "last"    || token_string == "LAST"   ||
+       token_string == "time_bucket" || token_string == "TIME_BUCKET")
         return token_t::FUNCTION;
 
     return token_t::IDENTITIFER;
@@ -184,7 +228,7 @@ token_t lexer::lex_operator(token_t::token_type token)
         else if(resolve_token_char(query[idx]) == token_t::EQUAL)
         {
             idx++;
-            return token_t(token_t::NEQUAL);
+            return token_t(token_t::LTEQ);
         }
     }
     if(token == token_t::GT) // >=
@@ -45,12 +45,20 @@ struct token_t
         LIMIT,
         OFFSET,
         AS,
+        INTO,
 
         SHOW,
         TABLES,
+        STATS,
 
         DESCRIBE,
         LOAD,
+        SORTED_BY,
+        CREATE_INDEX,
+        CREATE_TABLE,
+        ANALYZE,
+        EXPLAIN,
+        SET,
         EXIT,
 
         LEFT_JOIN,
@@ -61,9 +69,14 @@ struct token_t
         ON,
 
         FUNCTION,
+        OVER,
+        PARTITION_BY,
+        ORDER_BY,
+        ROWS,
 
         SELECT_ALL,
         NEGATE,
+        EXPLAIN_ANALYZE,
 
         INVALID
     };
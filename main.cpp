@@ -1,22 +1,114 @@
 #include <cstdio>
 #include <iostream>
+#include <thread>
 
+#include "metrics.hpp"
 #include "output_format.hpp"
+#include "scheduler.hpp"
+#include "server.hpp"
+#include "shared_tables.hpp"
+#include "slow_log.hpp"
 #include "sql_engine.hpp"
+#include "trace.hpp"
 
-format_t out_format = format_t::CSV;
+thread_local format_t out_format = format_t::CSV;
+bool analyze_on_load = false;
 
 void usage()
 {
-    printf("Usage: ./csvsql TABLE1=FILE_NAME1 TABLE2=FILE_NAME2... [(--execute query)]\n");
+    printf("Usage: ./csvsql [--analyze] [--shm] [--trace FILE.json] [--metrics FILE]\n"
+           "                [--slow-log FILE] [--slow-ms N] [--output csv|arrow|raw] [--threads N]\n"
+           "                [--serve SOCKET]\n"
+           "                TABLE1=FILE_NAME1 TABLE2=FILE_NAME2... [(--execute query)]\n"
+           "       ./csvsql [--output csv|arrow|raw] --connect SOCKET [(--execute query)]\n");
     exit(1);
 }
 
 int main(int argc, char** argv)
 {
     sql_engine engine;
+    std::string serve_path, connect_path;
+    unsigned int threads = std::thread::hardware_concurrency();
 
     int arg_idx = 1;
+    while(arg_idx < argc)
+    {
+        std::string flag(argv[arg_idx]);
+        if(flag == "--analyze")
+        {
+            analyze_on_load = true;
+            arg_idx++;
+        }
+        else if(flag == "--shm")
+        {
+            shared_tables = true;
+            arg_idx++;
+        }
+        else if(flag == "--metrics" && arg_idx + 1 < argc)
+        {
+            metrics.file_name = argv[arg_idx+1];
+            arg_idx += 2;
+        }
+        else if(flag == "--slow-log" && arg_idx + 1 < argc)
+        {
+            slow_log.file_name = argv[arg_idx+1];
+            arg_idx += 2;
+        }
+        else if(flag == "--slow-ms" && arg_idx + 1 < argc)
+        {
+            slow_log.threshold = atof(argv[arg_idx+1]);
+            arg_idx += 2;
+        }
+        else if(flag == "--output" && arg_idx + 1 < argc)
+        {
+            std::string format(argv[arg_idx+1]);
+            if(format == "csv")
+                out_format = format_t::CSV;
+            else if(format == "arrow")
+                out_format = format_t::ARROW;
+            else if(format == "raw")
+                out_format = format_t::RAW;
+            else
+                usage();
+            arg_idx += 2;
+        }
+        else if(flag == "--threads" && arg_idx + 1 < argc)
+        {
+            threads = atoi(argv[arg_idx+1]);
+            if(!threads)
+                usage();
+            arg_idx += 2;
+        }
+        else if(flag == "--serve" && arg_idx + 1 < argc)
+        {
+            serve_path = argv[arg_idx+1];
+            arg_idx += 2;
+        }
+        else if(flag == "--connect" && arg_idx + 1 < argc)
+        {
+            connect_path = argv[arg_idx+1];
+            arg_idx += 2;
+        }
+        else if(flag == "--trace" && arg_idx + 1 < argc)
+        {
+            start_trace(argv[arg_idx+1]);
+            arg_idx += 2;
+        }
+        else
+            break;
+    }
+    scheduler.start(threads);
+
+    // The server has the tables.
+    if(connect_path.size())
+    {
+        if(arg_idx == argc)
+            return run_client(connect_path, "");
+        if(arg_idx == argc - 2 && std::string(argv[arg_idx]) == "--execute")
+            return run_client(connect_path, argv[arg_idx+1]);
+        usage();
+    }
+
     for(arg_idx;
         arg_idx < argc && argv[arg_idx][0] != '-';
         arg_idx++)
@@ -31,18 +123,21 @@ int main(int argc, char** argv)
         engine.load_from_csv(table_name, file_name);
     }
 
-    if(arg_idx == argc)
+    if(arg_idx == argc && serve_path.size())
+    {
+        engine.serve(serve_path);
+    }
+    else if(arg_idx == argc)
     {
         engine.run_shell();
     }
-    else if(arg_idx == argc - 2)
+    else if(arg_idx == argc - 2 && serve_path.empty())
     {
         std::string command(argv[arg_idx]);
         std::string command_arg(argv[arg_idx+1]);
 
         if(command == "--execute")
         {
-            out_format = format_t::CSV;
             engine.process_line(command_arg);
         }
         else
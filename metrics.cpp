@@ -0,0 +1,207 @@
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/resource.h>
+
+#include "metrics.hpp"
+#include "query_limits.hpp"
+
+engine_metrics metrics;
+
+static const double bucket_bounds[] = { 1, 10, 100, 1000, 10000 };
+static const char*  bucket_names[]  = { "<=1ms", "<=10ms", "<=100ms", "<=1s", "<=10s", ">10s" };
+
+void latency_histogram::record(double milliseconds)
+{
+    unsigned int bucket = 0;
+    while(bucket < buckets - 1 && milliseconds > bucket_bounds[bucket])
+        bucket++;
+    counts[bucket]++;
+    count++;
+    total += milliseconds;
+    if(milliseconds > max)
+        max = milliseconds;
+}
+
+void engine_metrics::end_query(const std::string& statement, double milliseconds)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    latencies[statement].record(milliseconds);
+    query_bytes = current_query_bytes();
+}
+
+void engine_metrics::add_query_bytes(unsigned long long int total)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if(total > peak_query_bytes)
+        peak_query_bytes = total;
+}
+
+// Of the statement running on this thread.
+unsigned long long int engine_metrics::current_query_bytes()
+{
+    return limits.flags->bytes;
+}
+
+void engine_metrics::add_index_build(double milliseconds)
+{
+    index_builds++;
+
+    std::lock_guard<std::mutex> guard(lock);
+    index_build_time += milliseconds;
+}
+
+static unsigned long long int max_resident_bytes()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (unsigned long long int)usage.ru_maxrss * 1024;
+}
+
+void engine_metrics::show(table_map_t& tables)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    // Formatted apart from std::cout, which connections share, see server.hpp.
+    std::ostringstream out;
+    out << std::endl << std::setw(15) << std::left << "Statement" << " | "
+        << std::setw(8) << "Count" << " | " << std::setw(10) << "Total ms"
+        << " | " << std::setw(10) << "Max ms";
+    for(auto name : bucket_names)
+        out << " | " << std::setw(7) << name;
+    out << std::endl << std::string(16, '-') << "+" << std::string(10, '-')
+        << "+" << std::string(12, '-') << "+" << std::string(12, '-');
+    for(unsigned int i = 0; i < latency_histogram::buckets; i++)
+        out << "+" << std::string(9, '-');
+    out << std::endl;
+
+    for(auto& latency : latencies)
+    {
+        auto& histogram = latency.second;
+        out << std::setw(15) << latency.first << " | " << std::setw(8) << histogram.count
+            << " | " << std::setw(10) << histogram.total
+            << " | " << std::setw(10) << histogram.max;
+        for(auto count : histogram.counts)
+            out << " | " << std::setw(7) << count;
+        out << std::endl;
+    }
+
+    out << std::endl
+        << "Failed statements:     " << failed << std::endl
+        << "Rows scanned:          " << rows_scanned << std::endl
+        << "Rows emitted:          " << rows_emitted << std::endl
+        << "Bytes loaded:          " << bytes_loaded << std::endl
+        << "Indexes built:         " << index_builds << " in "
+                                     << index_build_time << "ms" << std::endl
+        << "Peak query memory:     " << peak_query_bytes << " bytes" << std::endl
+        << "Max resident memory:   " << max_resident_bytes() << " bytes" << std::endl;
+
+    if(tables.size())
+    {
+        out << std::endl << std::setw(15) << "Table" << " | "
+            << std::setw(10) << "Rows" << " | " << "Memory bytes" << std::endl
+            << std::string(16, '-') << "+" << std::string(12, '-') << "+"
+            << std::string(13, '-') << std::endl;
+        for(auto& table : tables)
+            out << std::setw(15) << table.first << " | " << std::setw(10)
+                << table.second->height << " | " << table.second->memory_bytes()
+                << std::endl;
+    }
+    out << std::endl;
+    std::cout << out.str() << std::flush;
+}
+
+static void metric_header(std::ostream& stream, const char* name,
+                          const char* type, const char* help)
+{
+    stream << "# HELP " << name << " " << help << std::endl
+           << "# TYPE " << name << " " << type << std::endl;
+}
+
+void engine_metrics::write_prometheus(std::ostream& stream, table_map_t& tables)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    metric_header(stream, "csvsql_statement_duration_seconds", "histogram",
+                  "Time to execute statements, by statement type.");
+    for(auto& latency : latencies)
+    {
+        auto& histogram = latency.second;
+        auto label = "{statement=\"" + latency.first + "\"";
+        unsigned long long int cumulative = 0;
+        for(unsigned int i = 0; i < latency_histogram::buckets; i++)
+        {
+            cumulative += histogram.counts[i];
+            stream << "csvsql_statement_duration_seconds_bucket" << label << ",le=\"";
+            if(i < latency_histogram::buckets - 1)
+                stream << bucket_bounds[i] / 1000;
+            else
+                stream << "+Inf";
+            stream << "\"} " << cumulative << std::endl;
+        }
+        stream << "csvsql_statement_duration_seconds_sum" << label << "} "
+               << histogram.total / 1000 << std::endl
+               << "csvsql_statement_duration_seconds_count" << label << "} "
+               << histogram.count << std::endl;
+    }
+
+    metric_header(stream, "csvsql_failed_statements_total", "counter",
+                  "Statements that failed to parse, compile or run.");
+    stream << "csvsql_failed_statements_total " << failed << std::endl;
+    metric_header(stream, "csvsql_rows_scanned_total", "counter",
+                  "Rows read from tables.");
+    stream << "csvsql_rows_scanned_total " << rows_scanned << std::endl;
+    metric_header(stream, "csvsql_rows_emitted_total", "counter",
+                  "Rows output by selects.");
+    stream << "csvsql_rows_emitted_total " << rows_emitted << std::endl;
+    metric_header(stream, "csvsql_loaded_bytes_total", "counter",
+                  "Bytes of csv files loaded.");
+    stream << "csvsql_loaded_bytes_total " << bytes_loaded << std::endl;
+    metric_header(stream, "csvsql_index_builds_total", "counter",
+                  "Indexes built, for CREATE_INDEX or joins.");
+    stream << "csvsql_index_builds_total " << index_builds << std::endl;
+    metric_header(stream, "csvsql_index_build_seconds_total", "counter",
+                  "Time spent building indexes.");
+    stream << "csvsql_index_build_seconds_total " << index_build_time / 1000 << std::endl;
+    metric_header(stream, "csvsql_query_memory_bytes", "gauge",
+                  "Bytes materialized and indexed by the last statement.");
+    stream << "csvsql_query_memory_bytes " << query_bytes << std::endl;
+    metric_header(stream, "csvsql_query_memory_peak_bytes", "gauge",
+                  "Most bytes materialized and indexed by any statement.");
+    stream << "csvsql_query_memory_peak_bytes " << peak_query_bytes << std::endl;
+    metric_header(stream, "csvsql_max_resident_bytes", "gauge",
+                  "Peak resident memory of the process.");
+    stream << "csvsql_max_resident_bytes " << max_resident_bytes() << std::endl;
+
+    metric_header(stream, "csvsql_table_rows", "gauge", "Rows of each loaded table.");
+    for(auto& table : tables)
+        stream << "csvsql_table_rows{table=\"" << table.first << "\"} "
+               << table.second->height << std::endl;
+    metric_header(stream, "csvsql_table_memory_bytes", "gauge",
+                  "Memory held by each loaded table and it's indexes.");
+    for(auto& table : tables)
+        stream << "csvsql_table_memory_bytes{table=\"" << table.first << "\"} "
+               << table.second->memory_bytes() << std::endl;
+}
+
+// Written to a temporary file first, so readers never see half of it.
+void engine_metrics::dump(table_map_t& tables)
+{
+    if(file_name == "")
+        return;
+
+    static std::mutex dumping;
+    std::lock_guard<std::mutex> guard(dumping);
+
+    auto temporary = file_name + ".tmp";
+    {
+        std::ofstream stream(temporary);
+        if(!stream)
+        {
+            std::cerr << "Error writing metrics: " << file_name << std::endl;
+            return;
+        }
+        write_prometheus(stream, tables);
+    }
+    std::rename(temporary.c_str(), file_name.c_str());
+}
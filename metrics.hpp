@@ -0,0 +1,71 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "table.hpp"
+
+// Counters of what the engine has done since it started,
+// shown by SHOW STATS, and written in the Prometheus text
+// format after every statement when run with --metrics FILE.
+// Updated by queries running on several threads when serving.
+
+// Latencies of one type of statement, in buckets
+// of at most 1ms, 10ms, 100ms, 1s, 10s, and over.
+struct latency_histogram
+{
+    static const unsigned int buckets = 6;
+
+    unsigned long long int counts[buckets] = {};
+    unsigned long long int count = 0;
+    double total = 0, max = 0;
+
+    void record(double milliseconds);
+};
+
+struct engine_metrics
+{
+    std::atomic<unsigned long long int> failed{0};
+    std::atomic<unsigned long long int> rows_scanned{0};
+    std::atomic<unsigned long long int> rows_emitted{0};
+    std::atomic<unsigned long long int> bytes_loaded{0};
+    std::atomic<unsigned long long int> index_builds{0};
+
+    // Held for the rest.
+    std::mutex lock;
+
+    // By statement type, i.e. SELECT
+    std::map<std::string, latency_histogram> latencies;
+
+    double index_build_time = 0;
+
+    // Bytes of tables materialized and indexes built by the
+    // last query to finish, and the most of any query.
+    unsigned long long int query_bytes = 0;
+    unsigned long long int peak_query_bytes = 0;
+
+    std::string file_name;
+
+    // Queries are counted on the thread they run on. Their
+    // memory is charged through query_limits, see query_limits.hpp,
+    // which passes the statement's total so far to add_query_bytes.
+    void end_query(const std::string& statement, double milliseconds);
+    void add_query_bytes(unsigned long long int total);
+    unsigned long long int current_query_bytes();
+
+    void add_index_build(double milliseconds);
+
+    void show(table_map_t& tables);
+    void write_prometheus(std::ostream& stream, table_map_t& tables);
+
+    // Rewrites file_name, if set.
+    void dump(table_map_t& tables);
+};
+
+extern engine_metrics metrics;
+
+#endif
@@ -9,9 +9,12 @@
 enum format_t
 {
     FORMATTED,
-    CSV
+    CSV,
+    ARROW,  // Arrow IPC stream
+    RAW     // Native column buffers, see columnar_output.hpp
 };
 
-extern format_t out_format;
+// Per thread, as each connection of a server has it's own.
+extern thread_local format_t out_format;
 
 #endif
@@ -1,8 +1,69 @@
+#include <cstring>
 #include <iostream>
+#include <iterator>
 
+#include "metrics.hpp"
+#include "query_limits.hpp"
+#include "scheduler.hpp"
 #include "table.hpp"
 #include "util.hpp"
 
+// Bytes of the csv split into rows per morsel.
+static const size_t parse_morsel_bytes = 1 << 20;
+
+// Lines split by split_lines, stopping at a line that hasn't
+// the number of columns expected, with got columns.
+struct parsed_lines
+{
+    std::vector<std::vector<char*>> rows;
+    size_t got;
+};
+
+// Splits the lines of buffer in [begin, end) into rows, until one
+// doesn't have columns values. Columns of 0 splits the first line
+// into rows[0]. Returns where it stopped.
+static size_t split_lines(char* buffer, size_t begin, size_t end, size_t columns,
+                          std::vector<std::vector<char*>>& rows, parsed_lines* lines)
+{
+    size_t field = begin;
+    std::vector<char*> tmp;
+    if(lines)
+        lines->got = columns;
+    for(size_t i = begin; i < end; i++)
+    {
+        char c = buffer[i];
+        if(c == ',' || c == '\n')
+        {
+            buffer[i] = 0;
+            tmp.push_back(&buffer[field]);
+            field = i + 1;
+        }
+
+        if(c == '\n')
+        {
+            if(!columns)
+            {
+                rows[0] = tmp;
+                return i + 1;
+            }
+            if(tmp.size() != columns)
+            {
+                lines->got = tmp.size();
+                return i + 1;
+            }
+            rows.push_back(tmp);
+            tmp.clear();
+            if(rows.size() % query_limits::check_rows == 0)
+            {
+                limits.check();
+                limits.charge(query_limits::check_rows *
+                              (columns * sizeof(char*) + sizeof(std::vector<char*>)));
+            }
+        }
+    }
+    return end;
+}
+
 // Convert a file into an vector of vector of c strings
 std::vector<std::vector<char*>> parse_csv(std::string& file_name)
 {
@@ -17,9 +78,19 @@ std::vector<std::vector<char*>> parse_csv(std::string& file_name)
         std::cerr << "Error reading file: " << file_name << std::endl;
         throw 0;
     }
-    auto len = ftell(fd);
+    size_t len = ftell(fd);
     rewind(fd);
 
+    try
+    {
+        limits.charge(len + 1);
+    }
+    catch(...)
+    {
+        fclose(fd);
+        throw;
+    }
+
     // A little hacky, but freeing this buffer is handled later
     // Due to the way the IR is constructed, ret[0][0] will hold this pointer
     char* buffer = (char*)malloc(sizeof(char) * (len + 1));
@@ -37,36 +108,54 @@ std::vector<std::vector<char*>> parse_csv(std::string& file_name)
         len++;
     }
     fclose(fd);
+    metrics.bytes_loaded += len;
 
-    std::vector<std::vector<char*>> ret;
+    // For now only hold pointers into our file buffer.
+    // The header gives the number of columns, and the lines
+    // after it are split in parallel, a morsel at a time.
+    std::vector<std::vector<char*>> ret(1);
+    size_t header_end = split_lines(buffer, 0, len, 0, ret, nullptr);
+    size_t columns = ret[0].size();
 
-    // For now only hold pointers into our file buffer
-    unsigned int begin = 0, columns = 0;
-    std::vector<char*> tmp(0);
-    for(unsigned int i = 0; i < len; i++)
+    std::vector<size_t> starts(1, header_end);
+    for(size_t at = header_end + parse_morsel_bytes; at < len; at += parse_morsel_bytes)
     {
-        char c = buffer[i];
-        if(c == ',' || c == '\n')
+        auto newline = (char*)memchr(buffer + at, '\n', len - at);
+        if(!newline || newline + 1 == buffer + len)
+            break;
+        at = newline + 1 - buffer;
+        starts.push_back(at);
+    }
+    starts.push_back(len);
+
+    std::vector<parsed_lines> morsels(starts.size() - 1);
+    try
+    {
+        parallel_for(morsels.size(), 1, [&](size_t begin, size_t end)
         {
-            buffer[i] = 0;
-            tmp.push_back(&buffer[begin]);
-            begin = i + 1;
-        }
+            for(size_t i = begin; i < end; i++)
+                split_lines(buffer, starts[i], starts[i+1], columns, morsels[i].rows, &morsels[i]);
+        });
+    }
+    catch(...)
+    {
+        // Cancelled, or past the deadline.
+        free(buffer);
+        throw;
+    }
 
-        if(c == '\n')
+    for(auto& morsel : morsels)
+    {
+        if(morsel.got != columns)
         {
-            if(columns == 0) columns = tmp.size();
-            if(tmp.size() != columns)
-            {
-                std::cerr << "Error reading " << file_name
-                    << ": mismatching column length on line " << ret.size() + 1
-                    << ". Expected: " << columns
-                    << ". Got: " << tmp.size() << std::endl;
-                exit(1);
-            }
-            ret.push_back(tmp);
-            tmp.resize(0);
+            std::cerr << "Error reading " << file_name
+                << ": mismatching column length on line " << ret.size() + morsel.rows.size() + 1
+                << ". Expected: " << columns
+                << ". Got: " << morsel.got << std::endl;
+            exit(1);
         }
+        ret.insert(ret.end(), std::make_move_iterator(morsel.rows.begin()),
+                              std::make_move_iterator(morsel.rows.end()));
     }
 
     return ret;
@@ -82,63 +171,97 @@ cell_type infer_type(const char* str)
     throw 0;
 }
 
-// Accumulates a type along a column.
-std::vector<cell_type> infer_column_types(std::vector<std::vector<char*>> ir)
+// Rows per morsel when inferring types and converting cells.
+static const size_t convert_morsel_rows = 1 << 14;
+
+// Accumulates a type along a column, over morsels of rows in
+// parallel. Reports the first unsupported cell.
+std::vector<cell_type> infer_column_types(const std::vector<std::vector<char*>>& ir)
 {
-    std::vector<cell_type> ret(ir[0].size(), cell_type::INT);
+    struct inferred
+    {
+        std::vector<cell_type> types;
+        size_t row = 0, column = 0;
+    };
 
-    for(unsigned int i = 1; i < ir.size(); i++)
+    size_t rows = ir.size() - 1;
+    std::vector<inferred> morsels((rows + convert_morsel_rows - 1) / convert_morsel_rows);
+    parallel_for(rows, convert_morsel_rows, [&](size_t begin, size_t end)
     {
-        for(unsigned int j = 0; j < ir[i].size(); j++)
+        limits.check();
+        auto& morsel = morsels[begin / convert_morsel_rows];
+        morsel.types = std::vector<cell_type>(ir[0].size(), cell_type::INT);
+        for(size_t i = begin + 1; i <= end; i++)
         {
-            // Int columns containing a float get promoted to float column
-            try
+            for(unsigned int j = 0; j < ir[i].size(); j++)
             {
-                if(infer_type(ir[i][j]) == cell_type::FLOAT)
+                // Int columns containing a float get promoted to float column
+                try
                 {
-                    ret[j] = cell_type::FLOAT;
+                    if(infer_type(ir[i][j]) == cell_type::FLOAT)
+                    {
+                        morsel.types[j] = cell_type::FLOAT;
+                    }
+                }
+                catch(int)
+                {
+                    morsel.row    = i;
+                    morsel.column = j;
+                    return;
                 }
             }
-            catch(int)
-            {
-                std::cerr << "Unsupported cell type in row "
-                          << i << " column " << j << std::endl;
-                throw;
-            }
         }
+    });
+
+    std::vector<cell_type> ret(ir[0].size(), cell_type::INT);
+    for(auto& morsel : morsels)
+    {
+        if(morsel.row)
+        {
+            std::cerr << "Unsupported cell type in row "
+                      << morsel.row << " column " << morsel.column << std::endl;
+            throw 0;
+        }
+        for(unsigned int j = 0; j < ret.size(); j++)
+            if(morsel.types[j] == cell_type::FLOAT)
+                ret[j] = cell_type::FLOAT;
     }
 
     return ret;
 }
 
 // Converts our c string csv IR into a column-wise representation of boost::variants.
-// Vector of columns.
-std::vector<std::vector<cell>> load_from_ir(std::vector<std::vector<char*>> ir,
-                                            std::vector<cell_type> column_types)
+// Vector of columns, converted over morsels of rows in parallel.
+std::vector<std::vector<cell>> load_from_ir(const std::vector<std::vector<char*>>& ir,
+                                            const std::vector<cell_type>& column_types)
 {
+    limits.charge((unsigned long long int)ir[0].size() * (ir.size() - 1) * sizeof(cell));
     std::vector<std::vector<cell>> ret(ir[0].size(),
                                        std::vector<cell>(ir.size()-1));
 
-    for(unsigned int i = 1; i < ir.size(); i++)
+    parallel_for(ir.size() - 1, convert_morsel_rows, [&](size_t begin, size_t end)
     {
-        for(unsigned int j = 0; j < ir[i].size(); j++)
+        limits.check();
+        for(size_t i = begin + 1; i <= end; i++)
         {
-            // Parse the c string representation and store in a boost::variant
-            // Makes accessing contents later simpler, especially putting
-            // values in maps for joins.
-            switch(column_types[j])
+            for(unsigned int j = 0; j < ir[i].size(); j++)
             {
-                case cell_type::INT:
-                    ret[j][i-1] = cell(atoll(ir[i][j]));
-                    break;
-                case cell_type::FLOAT:
-                    ret[j][i-1] = cell(atof(ir[i][j]));
-                    break;
-                    break;
-                default: break;
+                // Parse the c string representation and store in a boost::variant
+                // Makes accessing contents later simpler, especially putting
+                // values in maps for joins.
+                switch(column_types[j])
+                {
+                    case cell_type::INT:
+                        ret[j][i-1] = cell(atoll(ir[i][j]));
+                        break;
+                    case cell_type::FLOAT:
+                        ret[j][i-1] = cell(atof(ir[i][j]));
+                        break;
+                    default: break;
+                }
             }
         }
-    }
+    });
 
     // See line 22
     free(ir[0][0]);
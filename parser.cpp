@@ -9,10 +9,13 @@ int precedence(token_t t)
 {
     switch(t.t)
     {
-        case token_t::PAREN_OPEN:
+        case token_t::PAREN_OPEN: case token_t::EXPLAIN: case token_t::EXPLAIN_ANALYZE:
+        case token_t::CREATE_TABLE:
             return 0;
         case token_t::SELECT:     case token_t::SHOW:  case token_t::DESCRIBE:
-        case token_t::LOAD:
+        case token_t::LOAD:       case token_t::CREATE_INDEX:
+        case token_t::ANALYZE:    case token_t::INTO:
+        case token_t::SET:
             return 1;
         case token_t::LIMIT:      case token_t::OFFSET:
             return 2;
@@ -22,8 +25,10 @@ int precedence(token_t t)
             return 4;
         case token_t::AS:         case token_t::LEFT_JOIN:  case token_t::CROSS_JOIN:
         case token_t::RIGHT_JOIN: case token_t::OUTER_JOIN: case token_t::INNER_JOIN:
+        case token_t::SORTED_BY:
             return 5;
-        case token_t::ON:
+        case token_t::ON:         case token_t::PARTITION_BY:
+        case token_t::ORDER_BY:   case token_t::ROWS:
             return 6;
         case token_t::OR:
             return 7;
@@ -95,6 +100,7 @@ void bind_top(std::vector<token_t>& operations,
         case token_t::GT:    case token_t::GTEQ:
         case token_t::AND:   case token_t::OR:
         case token_t::AS:    case token_t::CROSS_JOIN:
+        case token_t::SORTED_BY: case token_t::INTO:
         {
             parse_tree.push_back(bind_binary(op, parse_tree));
             return;
@@ -102,7 +108,8 @@ void bind_top(std::vector<token_t>& operations,
         // Variadic
         case token_t::SELECT: case token_t::FROM:
         case token_t::WHERE:  case token_t::LIMIT:
-        case token_t::LOAD:
+        case token_t::LOAD:   case token_t::CREATE_INDEX:
+        case token_t::ANALYZE: case token_t::CREATE_TABLE:
         {
             // Bind all the values on the value stack to the
             // current operation.
@@ -150,6 +157,9 @@ void bind_top(std::vector<token_t>& operations,
         case token_t::OFFSET:   case token_t::SHOW:
         case token_t::DESCRIBE: case token_t::ON:
         case token_t::BANG:     case token_t::NEGATE:
+        case token_t::PARTITION_BY: case token_t::ORDER_BY:
+        case token_t::ROWS:     case token_t::EXPLAIN:
+        case token_t::EXPLAIN_ANALYZE: case token_t::SET:
         {
             std::vector<parse_tree_node> arg_list;
             arg_list.push_back(pop_back(parse_tree));
@@ -195,6 +205,7 @@ parse_tree_node parse(std::vector<token_t>& tokens)
             case token_t::FLOAT_LITERAL: case token_t::INT_LITERAL:
             case token_t::STR_LITERAL:   case token_t::IDENTITIFER:
             case token_t::TABLES:        case token_t::EXIT:
+            case token_t::STATS:
             {
                 // Push value onto the value stack if theres on empty operation to bind it.
                 // Commas are considered operation, so can separate values.
@@ -229,6 +240,25 @@ parse_tree_node parse(std::vector<token_t>& tokens)
                 }
                 break;
             }
+            // OVER follows the function call it applies to, which
+            // is already a value. Otherwise treated like a function,
+            // it's parenthesized window spec is bound on close paren.
+            case token_t::OVER:
+            {
+                if(parse_tree.size() &&
+                   parse_tree.back().a_type == parse_tree_node::VALUE &&
+                   parse_tree.back().token.t == token_t::FUNCTION)
+                {
+                    operations.push_back(token);
+                    parse_tree.push_back(parse_tree_node(parse_tree_node::OPERATION, token));
+                }
+                else
+                {
+                    std::cerr << "OVER must follow a function call." << std::endl;
+                    throw 0;
+                }
+                break;
+            }
             // Close paren binds all the operations on the operation stack until
             // an open paren.
             case token_t::PAREN_CLOSE:
@@ -271,6 +301,16 @@ parse_tree_node parse(std::vector<token_t>& tokens)
                     parse_tree.pop_back();           //FUNCTION
                     parse_tree.push_back(parse_tree_node(tmp, arg_list)); // Push as value
                 }
+                // Window spec, bind the function we're over as the first arg.
+                else if(parse_tree.size() &&
+                        parse_tree.back().token.t == token_t::OVER &&
+                        parse_tree.back().a_type != parse_tree_node::VALUE)
+                {
+                    auto tmp = pop_back(operations); //OVER
+                    parse_tree.pop_back();           //OVER
+                    arg_list.insert(arg_list.begin(), pop_back(parse_tree)); //FUNCTION
+                    parse_tree.push_back(parse_tree_node(tmp, arg_list)); // Push as value
+                }
                 else // Tuples not supported, 1 args == normal expression
                 {
                     if(arg_list.size() > 1)
@@ -301,6 +341,29 @@ parse_tree_node parse(std::vector<token_t>& tokens)
                 parse_tree.push_back(parse_tree_node(parse_tree_node::OPERATION, token));
                 break;
             }
+            // ANALYZE right after EXPLAIN runs the query being explained.
+            case token_t::ANALYZE:
+            {
+                if(operations.size() && operations.back().t == token_t::EXPLAIN &&
+                   parse_tree.back().a_type == parse_tree_node::OPERATION)
+                {
+                    operations.back().t       = token_t::EXPLAIN_ANALYZE;
+                    parse_tree.back().token.t = token_t::EXPLAIN_ANALYZE;
+                    break;
+                }
+                goto DEFAULT;
+            }
+            // AS after CREATE_TABLE name only reads well, the select
+            // that follows is bound straight to CREATE_TABLE.
+            case token_t::AS:
+            {
+                if(operations.size() && operations.back().t == token_t::CREATE_TABLE &&
+                   parse_tree.back().a_type == parse_tree_node::VALUE)
+                {
+                    break;
+                }
+                goto DEFAULT;
+            }
             // Resolve the semantics of minus and star symbol in the here.
             case token_t::MINUS:
             {
@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <cassert>
 #include <limits>
+#include <string>
 
 #include "../parser.hpp"
+#include "../query_limits.hpp"
 #include "../table.hpp"
 
 #include "aggregators.hpp"
@@ -12,7 +15,13 @@ struct max_t : aggregator_t
     T max;
     bool seen;
 
-    max_t(std::unique_ptr<expression_t>& expr_) : aggregator_t(expr_)
+    max_t(cell_type input_type,
+          const cell* input_) : aggregator_t(input_type, input_)
+    {
+        reset();
+    }
+
+    void reset()
     {
         seen = false;
         max  = std::numeric_limits<T>::lowest();
@@ -21,8 +30,14 @@ struct max_t : aggregator_t
     void accumulate()
     {
         seen = true;
-        auto candidate = expr->call();
-        if(*(T*)&candidate > max) max = *(T*)&candidate;
+        if(*(const T*)input > max) max = *(const T*)input;
+    }
+
+    void merge(aggregator_t& other)
+    {
+        auto& right = static_cast<max_t&>(other);
+        if(right.seen && (!seen || right.max > max)) max = right.max;
+        seen = seen || right.seen;
     }
 
     cell value()
@@ -42,7 +57,13 @@ struct min_t : aggregator_t
     T min;
     bool seen;
 
-    min_t(std::unique_ptr<expression_t>& expr_) : aggregator_t(expr_)
+    min_t(cell_type input_type,
+          const cell* input_) : aggregator_t(input_type, input_)
+    {
+        reset();
+    }
+
+    void reset()
     {
         seen = false;
         min  = std::numeric_limits<T>::max();
@@ -51,8 +72,14 @@ struct min_t : aggregator_t
     void accumulate()
     {
         seen = true;
-        auto candidate = expr->call();
-        if(*(T*)&candidate < min) min = *(T*)&candidate;
+        if(*(const T*)input < min) min = *(const T*)input;
+    }
+
+    void merge(aggregator_t& other)
+    {
+        auto& right = static_cast<min_t&>(other);
+        if(right.seen && (!seen || right.min < min)) min = right.min;
+        seen = seen || right.seen;
     }
 
     cell value()
@@ -67,7 +94,7 @@ struct min_t : aggregator_t
 };
 
 // Implements quick select pivot based selection algorithm.
-// We allocate up to all the space that might be necessary,
+// We reserve up to all the space that might be necessary,
 // although we may not fill them all as some views return a
 // speculative maximum height.
 template<typename T>
@@ -76,17 +103,39 @@ struct median_t : aggregator_t
     std::vector<T> vals;
     unsigned long long int seen;
 
-    median_t(std::unique_ptr<expression_t>& expr_,
-             from_t& from) : aggregator_t(expr_)
+    median_t(cell_type input_type,
+             const cell* input_,
+             from_t& from) : aggregator_t(input_type, input_)
     {
         seen = 0;
+        limits.charge((unsigned long long int)from.view->height() * sizeof(T));
         vals.reserve(from.view->height());
     }
 
+    void reset()
+    {
+        seen = 0;
+        vals.clear();
+    }
+
+    // Past the height reserved, growth is charged as it happens.
     void accumulate()
     {
-        auto val = expr->call();
-        vals[seen++] = *(T*)&val;
+        if(vals.size() == vals.capacity())
+            limits.charge((vals.capacity() ? vals.capacity() : 1) * sizeof(T));
+        vals.push_back(*(const T*)input);
+        seen++;
+    }
+
+    // Needs every value, so merging copies all of them again.
+    bool mergeable() { return false; }
+    void merge(aggregator_t& other)
+    {
+        auto& right = static_cast<median_t&>(other);
+        if(vals.size() + right.vals.size() > vals.capacity())
+            limits.charge((vals.size() + right.vals.size() - vals.capacity()) * sizeof(T));
+        vals.insert(vals.end(), right.vals.begin(), right.vals.end());
+        seen += right.seen;
     }
 
     // Partitions the underlying array around pivot,
@@ -177,20 +226,32 @@ struct average_t : aggregator_t
     T sum;
     unsigned long long int seen;
 
-    average_t(std::unique_ptr<expression_t>& expr_) : aggregator_t(expr_)
+    average_t(cell_type input_type,
+              const cell* input_) : aggregator_t(input_type, input_)
+    {
+        reset();
+        return_type = FLOAT;
+    }
+
+    void reset()
     {
         sum = 0;
         seen = 0;
-        return_type = FLOAT;
     }
 
     void accumulate()
     {
-        auto val = expr->call();
-        sum += *(T*)&val;
+        sum += *(const T*)input;
         seen++;
     }
 
+    void merge(aggregator_t& other)
+    {
+        auto& right = static_cast<average_t&>(other);
+        sum  += right.sum;
+        seen += right.seen;
+    }
+
     cell value()
     {
         if(!seen)
@@ -204,63 +265,367 @@ struct average_t : aggregator_t
     }
 };
 
-// Here we first compile the expression that the aggregator aggregates,
-// and construct the appropriate template.
 
-// Constructor takes the expression and sets the return type.
-std::unique_ptr<aggregator_t> aggregator_factory(parse_tree_node node, from_t& from)
+template<typename T>
+struct sum_t : aggregator_t
 {
-    if(node.args.size() != 1)
+    T sum;
+
+    sum_t(cell_type input_type,
+          const cell* input_) : aggregator_t(input_type, input_)
     {
-        std::cerr << "Only univariate aggregators supported." << std::endl;
-        throw 0;
+        reset();
+    }
+
+    void reset()
+    {
+        sum = 0;
+    }
+
+    void accumulate()
+    {
+        sum += *(const T*)input;
+    }
+
+    void merge(aggregator_t& other)
+    {
+        sum += static_cast<sum_t&>(other).sum;
+    }
+
+    cell value()
+    {
+        return *(cell*)&sum;
+    }
+};
+
+// First and last values seen, mostly useful with time_bucket
+// on ordered input, for the open and close of a bar.
+struct first_t : aggregator_t
+{
+    cell first;
+    bool seen;
+
+    first_t(cell_type input_type,
+            const cell* input_) : aggregator_t(input_type, input_)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        seen = false;
+    }
+
+    void accumulate()
+    {
+        if(!seen) first = *input;
+        seen = true;
+    }
+
+    void merge(aggregator_t& other)
+    {
+        auto& right = static_cast<first_t&>(other);
+        if(!seen && right.seen) first = right.first;
+        seen = seen || right.seen;
+    }
+
+    cell value()
+    {
+        if(!seen)
+        {
+            std::cerr << "Attempt to take first from empty tables." << std::endl;
+            throw 0;
+        }
+        return first;
     }
+};
 
-    auto expr = expression_factory(node.args[0], from);
-    auto return_type = expr->return_type;
+struct last_t : aggregator_t
+{
+    cell last;
+    bool seen;
 
+    last_t(cell_type input_type,
+           const cell* input_) : aggregator_t(input_type, input_)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        seen = false;
+    }
+
+    void accumulate()
+    {
+        last = *input;
+        seen = true;
+    }
+
+    void merge(aggregator_t& other)
+    {
+        auto& right = static_cast<last_t&>(other);
+        if(right.seen) last = right.last;
+        seen = seen || right.seen;
+    }
+
+    cell value()
+    {
+        if(!seen)
+        {
+            std::cerr << "Attempt to take last from empty tables." << std::endl;
+            throw 0;
+        }
+        return last;
+    }
+};
+
+// Leaf expression reading the final value of an aggregate.
+// Only valid once the aggregate_set has been finalized.
+struct aggregate_accessor : expression_t
+{
+    const cell* result;
+
+    aggregate_accessor(cell_type return_type_,
+                       const cell* result_) : result(result_)
+    {
+        return_type = return_type_;
+    }
+
+    cell call() override
+    {
+        return *result;
+    }
+};
+
+// Construct the appropriate template for the aggregate
+// function in node, reading it's input from the given slot.
+static std::unique_ptr<aggregator_t> aggregator_factory(parse_tree_node& node,
+                                                        cell_type input_type,
+                                                        const cell* input,
+                                                        from_t& from)
+{
     if(node.token.raw_rep == "max" ||
        node.token.raw_rep == "MAX")
     {
-        if(return_type == cell_type::INT)
+        if(input_type == cell_type::INT)
             return std::unique_ptr<aggregator_t>(
-                new max_t<long long int>(expr));
+                new max_t<long long int>(input_type, input));
         else
             return std::unique_ptr<aggregator_t>(
-                new max_t<double>(expr));
+                new max_t<double>(input_type, input));
     }
     else if(node.token.raw_rep == "min" ||
             node.token.raw_rep == "MIN")
     {
-        if(return_type == cell_type::INT)
+        if(input_type == cell_type::INT)
             return std::unique_ptr<aggregator_t>(
-                new min_t<long long int>(expr));
+                new min_t<long long int>(input_type, input));
         else
             return std::unique_ptr<aggregator_t>(
-                new min_t<double>(expr));
+                new min_t<double>(input_type, input));
     }
     else if(node.token.raw_rep == "median" ||
             node.token.raw_rep == "MEDIAN")
     {
-        if(return_type == cell_type::INT)
+        if(input_type == cell_type::INT)
             return std::unique_ptr<aggregator_t>(
-                new median_t<long long int>(expr, from));
+                new median_t<long long int>(input_type, input, from));
         else
             return std::unique_ptr<aggregator_t>(
-                new median_t<double>(expr, from));
+                new median_t<double>(input_type, input, from));
     }
     else if(node.token.raw_rep == "average" ||
             node.token.raw_rep == "AVERAGE")
     {
-        if(return_type == cell_type::INT)
+        if(input_type == cell_type::INT)
+            return std::unique_ptr<aggregator_t>(
+                new average_t<long long int>(input_type, input));
+        else
+            return std::unique_ptr<aggregator_t>(
+                new average_t<double>(input_type, input));
+    }
+
+    else if(node.token.raw_rep == "sum" ||
+            node.token.raw_rep == "SUM")
+    {
+        if(input_type == cell_type::INT)
             return std::unique_ptr<aggregator_t>(
-                new average_t<long long int>(expr));
+                new sum_t<long long int>(input_type, input));
         else
             return std::unique_ptr<aggregator_t>(
-                new average_t<double>(expr));
+                new sum_t<double>(input_type, input));
+    }
+
+    else if(node.token.raw_rep == "first" ||
+            node.token.raw_rep == "FIRST")
+    {
+        return std::unique_ptr<aggregator_t>(new first_t(input_type, input));
     }
-    else
+    else if(node.token.raw_rep == "last" ||
+            node.token.raw_rep == "LAST")
     {
-        assert(0);
+        return std::unique_ptr<aggregator_t>(new last_t(input_type, input));
     }
+
+    std::cerr << "Unknown aggregate function: " << node.token.raw_rep
+              << " (window functions require an OVER clause)." << std::endl;
+    throw 0;
+}
+
+// Here we first find or compile the expression that the aggregator
+// aggregates, then find or construct the aggregator itself.
+std::unique_ptr<expression_t> aggregate_set::accessor(parse_tree_node& node,
+                                                      from_t& from)
+{
+    if(node.token.raw_rep == "time_bucket" ||
+       node.token.raw_rep == "TIME_BUCKET")
+        return bucket_accessor(node, from);
+
+    if(node.args.size() != 1)
+    {
+        std::cerr << "Only univariate aggregators supported." << std::endl;
+        throw 0;
+    }
+
+    // Aggregate inputs are evaluated per row, so can't contain aggregates.
+    from_t input_from = from;
+    input_from.aggregates = nullptr;
+
+    auto input_key = expression_key(node.args[0], input_from);
+    unsigned int input_idx = std::find(input_keys.begin(), input_keys.end(), input_key)
+                                - input_keys.begin();
+    if(input_idx == input_keys.size())
+    {
+        inputs.emplace_back(expression_factory(node.args[0], input_from));
+        input_keys.push_back(input_key);
+        input_values.push_back(cell());
+    }
+
+    auto key = expression_key(node, input_from);
+    unsigned int aggregator_idx = std::find(aggregator_keys.begin(), aggregator_keys.end(), key)
+                                    - aggregator_keys.begin();
+    if(aggregator_idx == aggregator_keys.size())
+    {
+        aggregators.emplace_back(aggregator_factory(node,
+                                                    inputs[input_idx]->return_type,
+                                                    &input_values[input_idx],
+                                                    input_from));
+        aggregator_keys.push_back(key);
+        aggregator_nodes.push_back(node);
+        results.push_back(cell());
+    }
+
+    return std::unique_ptr<expression_t>(
+        new aggregate_accessor(aggregators[aggregator_idx]->return_type,
+                               &results[aggregator_idx]));
+}
+
+// time_bucket(expression, width) groups rows by expression rounded
+// down to a multiple of width. Only one bucketing per select, but
+// it may be referenced more than once.
+std::unique_ptr<expression_t> aggregate_set::bucket_accessor(parse_tree_node& node,
+                                                             from_t& from)
+{
+    // Parser constructs the arguments in reverse order.
+    if(node.args.size() != 2 ||
+       node.args[0].token.t != token_t::INT_LITERAL ||
+       node.args[0].token.value.i <= 0)
+    {
+        std::cerr << "time_bucket takes an expression and a positive integer width."
+                  << std::endl;
+        throw 0;
+    }
+
+    from_t input_from = from;
+    input_from.aggregates = nullptr;
+
+    auto key = expression_key(node, input_from);
+    if(!bucket)
+    {
+        bucket = expression_factory(node.args[1], input_from);
+        if(bucket->return_type != cell_type::INT)
+        {
+            std::cerr << "time_bucket requires an integer expression." << std::endl;
+            throw 0;
+        }
+        bucket_width = node.args[0].token.value.i;
+        bucket_key = key;
+    }
+    else if(key != bucket_key)
+    {
+        std::cerr << "Only one time_bucket per select supported." << std::endl;
+        throw 0;
+    }
+
+    return std::unique_ptr<expression_t>(
+        new aggregate_accessor(cell_type::INT, &bucket_value));
+}
+
+// Bucket of the current row, rounding towards negative infinity.
+long long int aggregate_set::current_bucket()
+{
+    long long int value = bucket->call().i;
+    long long int start = value - value % bucket_width;
+    if(value % bucket_width < 0) start -= bucket_width;
+    return start;
+}
+
+void aggregate_set::reset()
+{
+    for(auto& aggregator : aggregators)
+        aggregator->reset();
+}
+
+void aggregate_set::accumulate()
+{
+    for(unsigned int i = 0; i < inputs.size(); i++)
+        input_values[i] = inputs[i]->call();
+    for(auto& aggregator : aggregators)
+        aggregator->accumulate();
+}
+
+void aggregate_set::finalize()
+{
+    for(unsigned int i = 0; i < aggregators.size(); i++)
+        results[i] = aggregators[i]->value();
+}
+
+// Registering the same calls in the same order gives
+// the same aggregators at the same indexes.
+std::unique_ptr<aggregate_set> aggregate_set::partial(from_t& from)
+{
+    std::unique_ptr<aggregate_set> set(new aggregate_set());
+    for(auto& node : aggregator_nodes)
+        set->accessor(node, from);
+    return set;
+}
+
+bool aggregate_set::mergeable()
+{
+    for(auto& aggregator : aggregators)
+        if(!aggregator->mergeable())
+            return false;
+    return true;
+}
+
+void aggregate_set::merge(aggregate_set& other)
+{
+    for(unsigned int i = 0; i < aggregators.size(); i++)
+        aggregators[i]->merge(*other.aggregators[i]);
+}
+
+bool contains_aggregate(parse_tree_node& node)
+{
+    if(node.token.t == token_t::FUNCTION)
+        return true;
+    // Window functions produce a value per row
+    if(node.token.t == token_t::OVER)
+        return false;
+
+    for(auto& arg : node.args)
+        if(contains_aggregate(arg))
+            return true;
+
+    return false;
 }
@@ -1,53 +1,89 @@
 #ifndef _AGGREGREGATORS_H
 #define _AGGREGREGATORS_H
 
+#include <deque>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "expression.hpp"
 #include "from.hpp"
 #include "../parser.hpp"
 
-// Implementation of aggregators (max, min, average, median)
+// Implementation of aggregators (max, min, average, median, sum, first, last)
 // Abstract type with an accumulate method that is called
 // for each row we iterate over, and a value method
 // that should compute the aggregate value when we're done
 // iterating.
+
+// Aggregators don't own the expression they aggregate,
+// they read it's value for the current row from a slot
+// filled in by the aggregate_set below.
 struct aggregator_t
 {
     cell_type return_type;
-    std::unique_ptr<expression_t> expr;
+    const cell* input;
 
-    aggregator_t(std::unique_ptr<expression_t>& expr_) : expr(std::move(expr_))
-    {
-        return_type = expr->return_type;
-    }
+    aggregator_t(cell_type input_type,
+                 const cell* input_) : return_type(input_type), input(input_) {};
 
+    virtual void reset()      = 0;
     virtual void accumulate() = 0;
     virtual cell value()      = 0;
     virtual ~aggregator_t()   = default;
+
+    // Adds in what other, of the same type, accumulated
+    // over rows after ours.
+    virtual void merge(aggregator_t& other) = 0;
+
+    // Whether merging beats accumulating all the rows in one.
+    virtual bool mergeable() { return true; }
 };
 
-std::unique_ptr<aggregator_t> aggregator_factory(parse_tree_node, from_t&);
+// Owns all the aggregators of a single aggregate select.
 
-// Doing as<aggregate_t> would be incompatible,
-// have a container type that calls into aggregator_factory
-// for that use case.
-struct aggregator_container
+// Input expressions are deduplicated on their parse tree, so
+// max(PRICE), min(PRICE), average(PRICE) evaluate PRICE once per row,
+// and identical aggregates are only computed once.
+// Slots are held in deques so pointers to them stay valid as we add more.
+struct aggregate_set
 {
-    std::unique_ptr<aggregator_t> aggregator;
-
-    aggregator_container() = default;
-    aggregator_container(parse_tree_node node,
-                         from_t& from)
-    {
-        aggregator = aggregator_factory(node, from);
-    }
-    aggregator_container(aggregator_container && e) : aggregator(std::move(e.aggregator)) { }
-    aggregator_container& operator=(aggregator_container&& e)
-    {
-        aggregator = std::move(e.aggregator);
-        return *this;
-    }
+    std::vector<std::unique_ptr<expression_t>> inputs;
+    std::vector<std::string>                   input_keys;
+    std::deque<cell>                           input_values;
+
+    std::vector<std::unique_ptr<aggregator_t>> aggregators;
+    std::vector<std::string>                   aggregator_keys;
+    std::vector<parse_tree_node>               aggregator_nodes;
+    std::deque<cell>                           results;
+
+    // Set if the select is grouped by time_bucket.
+    std::unique_ptr<expression_t> bucket;
+    std::string                   bucket_key;
+    long long int                 bucket_width;
+    cell                          bucket_value;
+
+    // Registers the aggregate function call in node, and returns
+    // an expression that evaluates to it's value after finalize().
+    std::unique_ptr<expression_t> accessor(parse_tree_node& node, from_t& from);
+    std::unique_ptr<expression_t> bucket_accessor(parse_tree_node& node, from_t& from);
+
+    long long int current_bucket();
+
+    // Called once per row, then once after the last row of
+    // a group. reset() starts the next group.
+    void reset();
+    void accumulate();
+    void finalize();
+
+    // The same aggregates compiled against from, to accumulate
+    // part of the rows and merge() them into ours, in row order.
+    std::unique_ptr<aggregate_set> partial(from_t& from);
+    bool mergeable();
+    void merge(aggregate_set& other);
 };
 
+// Whether an expression contains an aggregate function call anywhere.
+bool contains_aggregate(parse_tree_node& node);
+
 #endif
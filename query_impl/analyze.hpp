@@ -0,0 +1,59 @@
+#ifndef _ANALYZE_H
+#define _ANALYZE_H
+
+#include <vector>
+
+#include "../parser.hpp"
+#include "../table.hpp"
+
+#include "identitifer.hpp"
+#include "query_object.hpp"
+
+// Recomputes the statistics of any number of tables,
+// i.e. analyze trades, quotes
+// They're shown by DESCRIBE, and used by the planner
+// to estimate row counts.
+struct analyze_t : query_object
+{
+    table_map_t* tables;
+    std::vector<identitifer_t> table_identitifers;
+
+    analyze_t() = default;
+    analyze_t(parse_tree_node& node,
+              table_map_t& tables_)
+    {
+        if(!node.args.size())
+        {
+            std::cerr << "INTERNAL: No args to ANALYZE." << std::endl;
+            throw 0;
+        }
+
+        for(auto& arg : node.args)
+        {
+            table_identitifers.push_back(identitifer_t(arg));
+        }
+
+        tables = &tables_;
+    }
+
+    void run() override
+    {
+        for(auto& t : table_identitifers)
+        {
+            if(tables->find(t.id) == tables->end())
+            {
+                std::cerr << "Could not resolve table name " << t.id << "." << std::endl;
+                throw 0;
+            }
+        }
+
+        // New versions of the tables, see catalog.hpp.
+        for(auto& t : table_identitifers)
+        {
+            auto version = std::make_shared<table>(*(*tables)[t.id]);
+            version->analyze();
+            (*tables)[t.id] = version;
+        }
+    }
+};
+#endif
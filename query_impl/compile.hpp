@@ -2,6 +2,7 @@
 #define _COMPILE_H
 
 #include <algorithm>
+#include <chrono>
 #include <climits>
 #include <iostream>
 #include <sstream>
@@ -13,18 +14,26 @@
 #include "../parser.hpp"
 #include "../table.hpp"
 #include "../table_views.hpp"
+#include "../slow_log.hpp"
+#include "../trace.hpp"
 
+#include "analyze.hpp"
 #include "as.hpp"
+#include "create_index.hpp"
+#include "create_table.hpp"
 #include "describe.hpp"
 #include "exit.hpp"
+#include "explain.hpp"
 #include "expression.hpp"
 #include "from.hpp"
 #include "identitifer.hpp"
 #include "limit.hpp"
 #include "load.hpp"
 #include "offset.hpp"
+#include "plan.hpp"
 #include "query_object.hpp"
 #include "select.hpp"
+#include "set.hpp"
 #include "show.hpp"
 #include "where.hpp"
 
@@ -41,11 +50,15 @@
 // where necessary.
 
 // Commands are implemented as a abstract class type that
-// must implement a run method (EXIT, SELECT, DESCRIBE, SHOW, LOAD).
+// must implement a run method (EXIT, SELECT, DESCRIBE, SHOW, LOAD,
+// CREATE_INDEX, CREATE_TABLE, ANALYZE, EXPLAIN, SET).
 
 // Certain types (JOIN, SELECT) also implement the table_view
 // interface.
 
+// SELECTs go through a logical plan (plan.hpp) first, which
+// the optimizer rewrites before the views are instantiated.
+
 
 std::unique_ptr<query_object> compile_query(parse_tree_node& node,
                                             table_map_t& tables)
@@ -68,9 +81,50 @@ std::unique_ptr<query_object> compile_query(parse_tree_node& node,
         {
             return std::unique_ptr<query_object>(new load_t(node, tables));
         }
+        case token_t::CREATE_INDEX:
+        {
+            return std::unique_ptr<query_object>(new create_index_t(node, tables));
+        }
+        case token_t::CREATE_TABLE:
+        case token_t::INTO:
+        {
+            return std::unique_ptr<query_object>(new create_table_t(node, tables));
+        }
+        case token_t::ANALYZE:
+        {
+            return std::unique_ptr<query_object>(new analyze_t(node, tables));
+        }
+        case token_t::SET:
+        {
+            return std::unique_ptr<query_object>(new set_t(node));
+        }
+        case token_t::EXPLAIN:
+        case token_t::EXPLAIN_ANALYZE:
+        {
+            return std::unique_ptr<query_object>(new explain_t(node, tables));
+        }
         case token_t::SELECT:
         {
-            return select_factory(node, tables);
+            std::unique_ptr<plan_node> plan;
+            {
+                trace_span span("plan");
+                plan = plan_factory(node, tables);
+            }
+            {
+                trace_span span("optimize");
+                optimize(plan, tables);
+            }
+            if(slow_log.enabled())
+                add_profiles(*plan, false);
+
+            trace_span span("build views");
+            auto start  = std::chrono::steady_clock::now();
+            auto select = select_factory(*plan, tables);
+            if(plan->profile)
+                plan->profile->build_time = std::chrono::duration<double, std::milli>(
+                                                std::chrono::steady_clock::now() - start).count();
+            select->plan = std::move(plan);
+            return select;
         }
     }
 
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <utility>
+
+#include "cost.hpp"
+
+static const double default_selectivity = 1.0 / 3;
+
+static double as_double(const cell& value, cell_type type)
+{
+    return type == cell_type::INT ? (double)value.i : value.d;
+}
+
+// Column of the select's source that one of it's columns reads directly,
+// -1 if it's computed.
+static int source_column(plan_node& select, int column)
+{
+    auto& source = *select.children[0];
+    int current = 0;
+    for(auto& expression : select.expressions)
+    {
+        if(expression.token.t == token_t::SELECT_ALL)
+        {
+            if(column < current + (int)source.column_names.size())
+                return column - current;
+            current += source.column_names.size();
+            continue;
+        }
+
+        if(current++ != column)
+            continue;
+
+        auto& value = expression.token.t == token_t::AS ? expression.args[0] : expression;
+        if(value.token.t != token_t::IDENTITIFER)
+            return -1;
+        return source.find_column(value.token.raw_rep);
+    }
+    return -1;
+}
+
+const column_stats* column_statistics(plan_node& node, int column,
+                                      cell_type& type, table_map_t& tables)
+{
+    if(column < 0)
+        return nullptr;
+
+    switch(node.type)
+    {
+        case plan_node::SCAN:
+        {
+            auto& source = *tables[node.table_id.token.raw_rep];
+            if(!source.height)
+                return nullptr;
+            type = source.column_types[column];
+            return &source.statistics(column);
+        }
+        case plan_node::FILTER:
+        case plan_node::LIMIT:
+            return column_statistics(*node.children[0], column, type, tables);
+        case plan_node::JOIN:
+        {
+            int left_width = node.children[0]->column_names.size();
+            if(column < left_width)
+                return column_statistics(*node.children[0], column, type, tables);
+            return column_statistics(*node.children[1], column - left_width, type, tables);
+        }
+        case plan_node::PROJECT:
+            return column_statistics(*node.children[0], source_column(node, column),
+                                     type, tables);
+        default:
+            return nullptr;
+    }
+}
+
+// Distinct values of the column, when node is estimated to have rows.
+static double distinct_in_rows(plan_node& node, int column, double rows, table_map_t& tables)
+{
+    cell_type type;
+    auto stats = column_statistics(node, column, type, tables);
+    if(!stats)
+        return std::max(rows, 1.0);
+    return std::max(std::min((double)stats->distinct, rows), 1.0);
+}
+
+double estimate_distinct(plan_node& node, int column, table_map_t& tables)
+{
+    return distinct_in_rows(node, column, estimate_rows(node, tables), tables);
+}
+
+// Fraction of the rows below value, interpolating within
+// the histogram bucket it falls in.
+static double fraction_below(const column_stats& stats, cell_type type, double value)
+{
+    auto& bounds = stats.histogram;
+    double buckets = bounds.size() - 1;
+    for(unsigned int i = 0; i + 1 < bounds.size(); i++)
+    {
+        double low  = as_double(bounds[i], type);
+        double high = as_double(bounds[i+1], type);
+        if(value < low)
+            return i / buckets;
+        if(value < high)
+            return (i + (value - low) / (high - low)) / buckets;
+    }
+    return 1;
+}
+
+// Fraction of the rows of node passing predicate.
+static double selectivity(parse_tree_node& predicate, plan_node& node, table_map_t& tables)
+{
+    switch(predicate.token.t)
+    {
+        case token_t::AND:
+            return selectivity(predicate.args[0], node, tables) *
+                   selectivity(predicate.args[1], node, tables);
+        case token_t::OR:
+        {
+            double left  = selectivity(predicate.args[0], node, tables);
+            double right = selectivity(predicate.args[1], node, tables);
+            return left + right - left * right;
+        }
+        case token_t::BANG:
+            return 1 - selectivity(predicate.args[0], node, tables);
+        case token_t::LT:    case token_t::LTEQ:
+        case token_t::GT:    case token_t::GTEQ:
+        case token_t::EQUAL: case token_t::NEQUAL:
+            break;
+        default:
+            return default_selectivity;
+    }
+
+    // Flip literal OP column around to column OP literal
+    auto op       = predicate.token.t;
+    auto* column  = &predicate.args[0];
+    auto* literal = &predicate.args[1];
+    if(literal->token.t == token_t::IDENTITIFER)
+    {
+        std::swap(column, literal);
+        switch(op)
+        {
+            case token_t::LT:   op = token_t::GT;   break;
+            case token_t::LTEQ: op = token_t::GTEQ; break;
+            case token_t::GT:   op = token_t::LT;   break;
+            case token_t::GTEQ: op = token_t::LTEQ; break;
+            default: break;
+        }
+    }
+
+    if(column->token.t != token_t::IDENTITIFER ||
+       (literal->token.t != token_t::INT_LITERAL &&
+        literal->token.t != token_t::FLOAT_LITERAL))
+        return default_selectivity;
+
+    int index = node.find_column(column->token.raw_rep);
+    if(op == token_t::EQUAL)
+        return 1 / estimate_distinct(node, index, tables);
+    if(op == token_t::NEQUAL)
+        return 1 - 1 / estimate_distinct(node, index, tables);
+
+    cell_type type;
+    auto stats = column_statistics(node, index, type, tables);
+    if(!stats)
+        return default_selectivity;
+
+    double value = as_double(literal->token.value,
+                             literal->token.t == token_t::INT_LITERAL ? cell_type::INT
+                                                                      : cell_type::FLOAT);
+    double below = fraction_below(*stats, type, value);
+    return op == token_t::LT || op == token_t::LTEQ ? below : 1 - below;
+}
+
+static bool contains_bucket(parse_tree_node& node)
+{
+    if(node.token.t == token_t::FUNCTION &&
+       (node.token.raw_rep == "time_bucket" || node.token.raw_rep == "TIME_BUCKET"))
+        return true;
+
+    for(auto& arg : node.args)
+        if(contains_bucket(arg))
+            return true;
+    return false;
+}
+
+double estimate_rows(plan_node& node, table_map_t& tables)
+{
+    switch(node.type)
+    {
+        case plan_node::SCAN:
+            return tables[node.table_id.token.raw_rep]->height;
+        case plan_node::FILTER:
+        {
+            double rows = estimate_rows(*node.children[0], tables);
+            for(auto& predicate : node.predicates)
+                rows *= selectivity(predicate, *node.children[0], tables);
+            return rows;
+        }
+        case plan_node::LIMIT:
+        {
+            double rows = estimate_rows(*node.children[0], tables) - node.offset.offset;
+            return std::max(std::min(rows, (double)node.limit.limit), 0.0);
+        }
+        case plan_node::PROJECT:
+            return estimate_rows(*node.children[0], tables);
+        case plan_node::AGGREGATE:
+        {
+            // Buckets we can't guess, assume the worst.
+            for(auto& expression : node.expressions)
+                if(contains_bucket(expression))
+                    return estimate_rows(*node.children[0], tables);
+            return 1;
+        }
+        case plan_node::JOIN:
+        {
+            auto& left  = *node.children[0];
+            auto& right = *node.children[1];
+            double left_rows  = estimate_rows(left, tables);
+            double right_rows = estimate_rows(right, tables);
+            if(node.join_type.t == token_t::CROSS_JOIN)
+                return left_rows * right_rows;
+
+            // Each row matches the rows sharing it's key on the other side,
+            // assuming the side with fewer keys has all it's keys in the other.
+            double distinct = std::max(left_rows, right_rows);
+            if(node.on.args.size() == 1 && node.on.args[0].args.size() == 2 &&
+               node.on.args[0].args[0].token.t == token_t::IDENTITIFER &&
+               node.on.args[0].args[1].token.t == token_t::IDENTITIFER)
+            {
+                int left_column  = left.find_column(node.on.args[0].args[0].token.raw_rep);
+                int right_column = right.find_column(node.on.args[0].args[1].token.raw_rep);
+                // With the rows we have, as estimating them again for each
+                // side would take time exponential in the depth of the joins.
+                distinct = std::max(distinct_in_rows(left, left_column, left_rows, tables),
+                                    distinct_in_rows(right, right_column, right_rows, tables));
+            }
+            double rows = left_rows * right_rows / distinct;
+
+            switch(node.join_type.t)
+            {
+                case token_t::LEFT_JOIN:  return std::max(rows, left_rows);
+                case token_t::RIGHT_JOIN: return std::max(rows, right_rows);
+                case token_t::OUTER_JOIN: return std::max(rows, left_rows + right_rows);
+                default:                  return rows;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef _COST_H
+#define _COST_H
+
+#include "../table.hpp"
+
+#include "plan.hpp"
+
+// Cardinality estimates for plan nodes, from the statistics
+// of the tables they read. Tables are analyzed on first use.
+
+// Filters on a column compared to a constant use the column's
+// range and distinct values, assuming they're uniform and
+// independent, anything else is guessed at a third of the rows.
+
+// Estimated rows a node outputs.
+double estimate_rows(plan_node& node, table_map_t& tables);
+
+// Estimated distinct values in a column of a node's output.
+double estimate_distinct(plan_node& node, int column, table_map_t& tables);
+
+// Statistics of the table column that a column of a node's output
+// passes through unchanged, nullptr if there isn't one.
+const column_stats* column_statistics(plan_node& node, int column,
+                                      cell_type& type, table_map_t& tables);
+
+#endif
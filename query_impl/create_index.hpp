@@ -0,0 +1,101 @@
+#ifndef _CREATE_INDEX_H
+#define _CREATE_INDEX_H
+
+#include <algorithm>
+#include <string>
+
+#include "../parser.hpp"
+#include "../table.hpp"
+
+#include "identitifer.hpp"
+#include "query_object.hpp"
+
+// CREATE_INDEX name ON table.column
+
+// Builds a persistent index on a column of a loaded table.
+// Joins on the column use it rather than building their own,
+// and WHERE filters on it visit only the matching rows when
+// they're selective enough.
+struct create_index_t : query_object
+{
+    table_map_t* tables;
+    std::string name;
+    std::string table_name;
+    std::string column_name;
+
+    create_index_t() = default;
+    create_index_t(parse_tree_node& node,
+                   table_map_t& tables_)
+    {
+        // Parser constructs the arguments in reverse order.
+        if(node.args.size() != 2 ||
+           node.args[0].token.t != token_t::ON ||
+           node.args[1].token.t != token_t::IDENTITIFER)
+        {
+            std::cerr << "Expected CREATE_INDEX name ON table.column." << std::endl;
+            throw 0;
+        }
+
+        name = identitifer_t(node.args[1]).id;
+        auto target = identitifer_t(node.args[0].args[0]).id;
+
+        auto dot = target.find('.');
+        if(dot == std::string::npos)
+        {
+            std::cerr << "Expected CREATE_INDEX name ON table.column." << std::endl;
+            throw 0;
+        }
+        table_name  = target.substr(0, dot);
+        column_name = target.substr(dot + 1);
+
+        tables = &tables_;
+    }
+
+    void run() override
+    {
+        auto found = tables->find(table_name);
+        if(found == tables->end())
+        {
+            std::cerr << "Could not resolve table name " << table_name << "." << std::endl;
+            throw 0;
+        }
+        auto& indexed = *found->second;
+
+        auto column = std::find(indexed.column_names.begin(),
+                                indexed.column_names.end(),
+                                column_name) - indexed.column_names.begin();
+        if(column == indexed.width)
+        {
+            std::cerr << "Could not resolve column " << column_name
+                      << " in " << table_name << "." << std::endl;
+            throw 0;
+        }
+
+        for(auto& t : *tables)
+        {
+            for(auto& index : t.second->indexes)
+            {
+                if(index->name == name)
+                {
+                    std::cerr << "Invalid input: Attempted to create more than one"
+                              << " index of the same name.    " << name << std::endl;
+                    throw 0;
+                }
+            }
+        }
+
+        if(indexed.find_index(column))
+        {
+            std::cerr << "Column " << column_name << " in " << table_name
+                      << " is already indexed." << std::endl;
+            throw 0;
+        }
+
+        // A new version of the table, queries running on
+        // the old one keep it, see catalog.hpp.
+        auto version = std::make_shared<table>(indexed);
+        version->create_index(name, column);
+        found->second = version;
+    }
+};
+#endif
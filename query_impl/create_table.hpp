@@ -0,0 +1,73 @@
+#ifndef _CREATE_TABLE_H
+#define _CREATE_TABLE_H
+
+#include <memory>
+#include <string>
+
+#include "../parser.hpp"
+#include "../slow_log.hpp"
+#include "../table.hpp"
+
+#include "explain.hpp"
+#include "identitifer.hpp"
+#include "plan.hpp"
+#include "query_object.hpp"
+#include "select.hpp"
+
+// CREATE_TABLE name AS SELECT ...
+// SELECT ... INTO name
+
+// Runs the select into a new table, held in memory like a loaded
+// csv, so intermediate results can be queried without writing
+// them out and loading them back.
+struct create_table_t : query_object
+{
+    table_map_t* tables;
+    std::string name;
+
+    create_table_t(parse_tree_node& node,
+                   table_map_t& tables_) : tables(&tables_)
+    {
+        // CREATE_TABLE's args are reversed by the parser, INTO's aren't,
+        // so both have the select then the name.
+        if(node.args.size() != 2 ||
+           node.args[0].token.t != token_t::SELECT ||
+           node.args[1].token.t != token_t::IDENTITIFER)
+        {
+            std::cerr << "Expected CREATE_TABLE name AS SELECT ... "
+                      << "or SELECT ... INTO name." << std::endl;
+            throw 0;
+        }
+
+        name = identitifer_t(node.args[1]).id;
+
+        auto planned = plan_factory(node.args[0], tables_);
+        optimize(planned, tables_);
+        if(slow_log.enabled())
+            add_profiles(*planned, false);
+        plan = std::move(planned);
+    }
+
+    void run() override
+    {
+        if(tables->find(name) != tables->end())
+        {
+            std::cerr << "Invalid input: Attempted to create more than one"
+                      << " table of the same name.    " << name << std::endl;
+            throw 0;
+        }
+
+        std::shared_ptr<table> created;
+        {
+            auto select = select_factory(*plan, *tables);
+            created = std::make_shared<table>(*select);
+        }
+        if(analyze_on_load)
+            created->analyze();
+        if(plan->profile)
+            plan->profile->rows = created->height;
+
+        tables->emplace(std::make_pair(name, created));
+    }
+};
+#endif
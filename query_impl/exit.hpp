@@ -1,6 +1,8 @@
 #ifndef _EXIT_H
 #define _EXIT_H
 
+#include "../server.hpp"
+
 #include "query_object.hpp"
 
 // Self - explanatory. Due to the parsing stage
@@ -11,6 +13,13 @@ struct exit_t : query_object
     void run() override
     {
         std::cerr << "Bye bye" << std::endl;
+
+        // Serving, only the connection ends.
+        if(connection.fd >= 0)
+        {
+            connection.closing = true;
+            return;
+        }
         exit(0);
     }
 };
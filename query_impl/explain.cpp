@@ -0,0 +1,262 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "explain.hpp"
+
+#include "cost.hpp"
+#include "select.hpp"
+
+static std::string binary_operator(token_t::token_type t)
+{
+    switch(t)
+    {
+        case token_t::PLUS:   return "+";
+        case token_t::MINUS:  return "-";
+        case token_t::STAR:   return "*";
+        case token_t::DIVIDE: return "/";
+        case token_t::MOD:    return "%";
+        case token_t::CARAT:  return "^";
+        case token_t::EQUAL:  return "=";
+        case token_t::NEQUAL: return "<>";
+        case token_t::LT:     return "<";
+        case token_t::LTEQ:   return "<=";
+        case token_t::GT:     return ">";
+        case token_t::GTEQ:   return ">=";
+        case token_t::AND:    return "AND";
+        case token_t::OR:     return "OR";
+        default:              return "";
+    }
+}
+
+// Expression as it would be written, parenthesizing
+// nested binary operations. Args of functions and
+// window specs are stored reversed.
+static std::string expression_text(parse_tree_node& node)
+{
+    std::stringstream stream;
+    auto op = binary_operator(node.token.t);
+    if(op != "" && node.args.size() == 2)
+    {
+        for(unsigned int i = 0; i < 2; i++)
+        {
+            bool nested = binary_operator(node.args[i].token.t) != "" &&
+                          node.args[i].args.size() == 2;
+            if(i)
+                stream << " " << op << " ";
+            stream << (nested ? "(" : "") << expression_text(node.args[i])
+                   << (nested ? ")" : "");
+        }
+        return stream.str();
+    }
+
+    switch(node.token.t)
+    {
+        case token_t::INT_LITERAL:   stream << node.token.value.i;            break;
+        case token_t::FLOAT_LITERAL: stream << node.token.value.d;            break;
+        case token_t::STR_LITERAL:   stream << "'" << node.token.raw_rep << "'"; break;
+        case token_t::SELECT_ALL:    stream << "*";                           break;
+        case token_t::NEGATE:        stream << "-" << expression_text(node.args[0]); break;
+        case token_t::BANG:          stream << "!" << expression_text(node.args[0]); break;
+        case token_t::AS:
+            stream << expression_text(node.args[0]) << " AS " << node.args[1].token.raw_rep;
+            break;
+        case token_t::PARTITION_BY: case token_t::ORDER_BY: case token_t::ROWS:
+            stream << output_token(node.token) << " " << expression_text(node.args[0]);
+            break;
+        case token_t::FUNCTION:
+            stream << node.token.raw_rep << "(";
+            for(unsigned int i = node.args.size(); i > 0; i--)
+                stream << expression_text(node.args[i-1]) << (i > 1 ? ", " : "");
+            stream << ")";
+            break;
+        case token_t::OVER:
+            stream << expression_text(node.args[0]) << " OVER (";
+            for(unsigned int i = node.args.size(); i > 1; i--)
+                stream << expression_text(node.args[i-1]) << (i > 2 ? ", " : "");
+            stream << ")";
+            break;
+        default:
+            stream << node.token.raw_rep;
+            break;
+    }
+    return stream.str();
+}
+
+static std::string join_text(std::vector<parse_tree_node>& expressions,
+                             const std::string& separator)
+{
+    std::string text;
+    for(unsigned int i = 0; i < expressions.size(); i++)
+        text += (i ? separator : "") + expression_text(expressions[i]);
+    return text;
+}
+
+static std::string side_text(int side)
+{
+    return side == 0 ? "left" : side == 1 ? "right" : "smaller side";
+}
+
+// Nodes a select takes over, as select_factory does.
+static plan_node* select_source(plan_node& node, plan_node** limit, plan_node** filter)
+{
+    auto* source = node.children[0].get();
+    if(source->type == plan_node::LIMIT)
+    {
+        *limit = source;
+        source = source->children[0].get();
+    }
+    if(source->type == plan_node::FILTER)
+    {
+        *filter = source;
+        source = source->children[0].get();
+    }
+    return source;
+}
+
+std::string operator_text(plan_node& node, std::vector<plan_node*>& inputs)
+{
+    std::stringstream stream;
+    switch(node.type)
+    {
+        case plan_node::SCAN:
+            stream << "Scan " << node.table_id.token.raw_rep;
+            if(node.name != node.table_id.token.raw_rep)
+                stream << " AS " << node.name;
+            break;
+        case plan_node::FILTER:
+            stream << "Filter " << join_text(node.predicates, " AND ");
+            break;
+        case plan_node::LIMIT:
+            stream << "Limit " << node.limit.limit << " OFFSET " << node.offset.offset;
+            break;
+        case plan_node::JOIN:
+        {
+            switch(node.join_type.t)
+            {
+                case token_t::INNER_JOIN: stream << "Inner join"; break;
+                case token_t::LEFT_JOIN:  stream << "Left join";  break;
+                case token_t::RIGHT_JOIN: stream << "Right join"; break;
+                case token_t::OUTER_JOIN: stream << "Outer join"; break;
+                default:                  stream << "Cross join"; break;
+            }
+            if(node.join_type.t != token_t::CROSS_JOIN)
+                stream << " ON " << expression_text(node.on.args[0]);
+            if(node.join_type.t == token_t::INNER_JOIN)
+                stream << ", index " << side_text(node.build_side);
+            if(node.name != "")
+                stream << " AS " << node.name;
+            break;
+        }
+        case plan_node::PROJECT:
+        case plan_node::AGGREGATE:
+        {
+            plan_node* limit  = nullptr;
+            plan_node* filter = nullptr;
+            inputs.push_back(select_source(node, &limit, &filter));
+
+            stream << (node.type == plan_node::PROJECT ? "Project " : "Aggregate ")
+                   << join_text(node.expressions, ", ");
+            if(filter)
+                stream << " WHERE " << join_text(filter->predicates, " AND ");
+            if(limit)
+                stream << " LIMIT " << limit->limit.limit
+                       << " OFFSET " << limit->offset.offset;
+            if(node.name != "")
+                stream << " AS " << node.name;
+            return stream.str();
+        }
+    }
+
+    for(auto& child : node.children)
+        inputs.push_back(child.get());
+    return stream.str();
+}
+
+static void explain_node(std::ostream& out, plan_node& node, table_map_t& tables, int depth)
+{
+    std::string indent(depth * 2, ' ');
+    std::vector<plan_node*> inputs;
+    out << indent << operator_text(node, inputs);
+
+    out << " (estimated rows " << std::fixed << std::setprecision(0)
+        << estimate_rows(node, tables) << ")" << std::endl;
+
+    if(node.profile)
+    {
+        auto& profile = *node.profile;
+        out << indent << "    rows " << profile.rows;
+        if(inputs.size())
+        {
+            out << " of ";
+            for(unsigned int i = 0; i < inputs.size(); i++)
+                out << (i ? " + " : "") << inputs[i]->profile->rows;
+        }
+        out << std::setprecision(3) << ", build " << profile.build_time
+            << "ms, run " << profile.run_time << "ms";
+        if(profile.index_side >= 0)
+            out << ", index " << side_text(profile.index_side) << " with "
+                << profile.index_keys << " keys"
+                << (profile.persistent_index ? " (persistent)" : "");
+        if(profile.bytes_materialized)
+            out << ", materialized " << profile.bytes_materialized << " bytes";
+        out << std::endl;
+    }
+
+    for(auto* input : inputs)
+        explain_node(out, *input, tables, depth + 1);
+}
+
+void add_profiles(plan_node& node, bool timed)
+{
+    node.profile = std::make_shared<plan_profile>();
+    node.profile->timed = timed;
+    for(auto& child : node.children)
+        add_profiles(*child, timed);
+}
+
+explain_t::explain_t(parse_tree_node& node, table_map_t& tables_) : tables(&tables_)
+{
+    if(node.args.size() != 1 || node.args[0].token.t != token_t::SELECT)
+    {
+        std::cerr << "EXPLAIN expects a SELECT." << std::endl;
+        throw 0;
+    }
+
+    analyze = node.token.t == token_t::EXPLAIN_ANALYZE;
+    plan    = plan_factory(node.args[0], tables_);
+    optimize(plan, tables_);
+    if(analyze)
+        add_profiles(*plan, true);
+}
+
+// The select at the root isn't a view, so it's measured here.
+void explain_t::run()
+{
+    if(analyze)
+    {
+        auto& profile = *plan->profile;
+        auto start = std::chrono::steady_clock::now();
+        auto select = select_factory(*plan, *tables);
+        auto built = std::chrono::steady_clock::now();
+
+        auto width = select->width();
+        while(!select->empty())
+        {
+            for(unsigned int i = 0; i < width; i++)
+                select->access_column(i);
+            select->advance_row();
+            profile.rows++;
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        profile.build_time = std::chrono::duration<double, std::milli>(built - start).count();
+        profile.run_time   = std::chrono::duration<double, std::milli>(end - built).count();
+    }
+
+    // Formatted apart from std::cout, which connections share, see server.hpp.
+    std::ostringstream out;
+    explain_node(out, *plan, *tables, 0);
+    std::cout << out.str() << std::flush;
+}
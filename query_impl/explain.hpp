@@ -0,0 +1,39 @@
+#ifndef _EXPLAIN_H
+#define _EXPLAIN_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../parser.hpp"
+#include "../table.hpp"
+
+#include "plan.hpp"
+#include "query_object.hpp"
+
+// EXPLAIN SELECT ... prints the operators that would run the
+// optimized plan of the select, with their estimated row counts.
+
+// EXPLAIN ANALYZE SELECT ... also runs it, discarding the rows,
+// and reports for each operator the rows it produced and read,
+// the time spent building and running it, the index of joins
+// and the bytes materialized for it's parent. Times include
+// the operators below, and the overhead of timing every row.
+struct explain_t : query_object
+{
+    table_map_t* tables;
+    std::unique_ptr<plan_node> plan;
+    bool analyze;
+
+    explain_t(parse_tree_node& node, table_map_t& tables_);
+    void run() override;
+};
+
+// Text of the operator a plan node runs as, with the nodes it reads
+// from added to inputs. Selects read past the WHERE and LIMIT they fuse.
+std::string operator_text(plan_node& node, std::vector<plan_node*>& inputs);
+
+// Profiles the whole plan, see plan_profile.
+void add_profiles(plan_node& node, bool timed);
+
+#endif
@@ -1,8 +1,14 @@
+#include <algorithm>
+#include <cctype>
+#include <string>
+
 #include "../lexer.hpp"
 #include "../parser.hpp"
 
+#include "aggregators.hpp"
 #include "expression.hpp"
 #include "expression_impl.hpp"
+#include "window.hpp"
 
 std::unique_ptr<expression_t> expression_factory(parse_tree_node node, from_t& from)
 {
@@ -10,7 +16,44 @@ std::unique_ptr<expression_t> expression_factory(parse_tree_node node, from_t& f
     {
         case token_t::IDENTITIFER:
         {
-            return std::unique_ptr<expression_t>(new column_accessor(node, from));
+            // Resolved first, so unknown columns are reported as such.
+            std::unique_ptr<expression_t> accessor(new column_accessor(node, from));
+
+            // Aggregate selects produce a single row, so bare columns
+            // can only be referenced inside an aggregate.
+            if(from.aggregates)
+            {
+                std::cerr << "Column " << node.token.raw_rep
+                          << " must be used inside an aggregate." << std::endl;
+                throw 0;
+            }
+            return accessor;
+        }
+        case token_t::FUNCTION:
+        {
+            if(!from.aggregates)
+            {
+                std::cerr << "Aggregate " << node.token.raw_rep
+                          << " not allowed here." << std::endl;
+                throw 0;
+            }
+            return from.aggregates->accessor(node, from);
+        }
+        case token_t::OVER:
+        {
+            if(from.aggregates)
+            {
+                std::cerr << "Window function " << node.args[0].token.raw_rep
+                          << " not allowed in an aggregate select." << std::endl;
+                throw 0;
+            }
+            if(!from.windows)
+            {
+                std::cerr << "Window function " << node.args[0].token.raw_rep
+                          << " not allowed here." << std::endl;
+                throw 0;
+            }
+            return from.windows->accessor(node, from);
         }
         case token_t::INT_LITERAL:
         case token_t::FLOAT_LITERAL:
@@ -58,3 +101,33 @@ std::unique_ptr<expression_t> expression_factory(std::string column, from_t& fro
 {
     return std::unique_ptr<expression_t>(new column_accessor(column, from));
 }
+
+// Canonical representation of an expression, used to find
+// identical expressions. Columns are keyed on their resolved
+// index, so TIME and trades.TIME are considered the same.
+std::string expression_key(parse_tree_node& node, from_t& from)
+{
+    std::string key;
+    switch(node.token.t)
+    {
+        case token_t::IDENTITIFER:
+            return "#" + std::to_string(from.view->resolve_column(node.token.raw_rep));
+        case token_t::INT_LITERAL:
+        case token_t::FLOAT_LITERAL:
+            return output_token(node.token.t) + " " + std::to_string(node.token.value.i);
+        case token_t::FUNCTION:
+            key = node.token.raw_rep;
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            break;
+        default:
+            key = output_token(node.token);
+            break;
+    }
+
+    key += "(";
+    for(auto& arg : node.args)
+        key += expression_key(arg, from) + ",";
+    key += ")";
+
+    return key;
+}
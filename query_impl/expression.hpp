@@ -2,6 +2,7 @@
 #define _EXPRESSION_H
 
 #include <memory>
+#include <string>
 
 #include "../parser.hpp"
 #include "../table.hpp"
@@ -23,6 +24,9 @@ struct expression_t
 std::unique_ptr<expression_t> expression_factory(parse_tree_node, from_t&);
 std::unique_ptr<expression_t> expression_factory(std::string column, from_t& from);
 
+// Canonical representation of an expression, equal for identical expressions.
+std::string expression_key(parse_tree_node& node, from_t& from);
+
 // Doing as<expression_t> would be incompatible,
 // have a container type for that use case.
 struct expression_container
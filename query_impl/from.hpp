@@ -9,12 +9,25 @@ struct from_t;
 #include "../table.hpp"
 #include "../table_views.hpp"
 
+struct aggregate_set;
+struct plan_node;
+struct window_view;
+
 struct from_t
 {
     std::shared_ptr<table_view> view;
 
+    // Set while compiling the output columns of an aggregate
+    // select, so that aggregate function calls inside expressions
+    // can be registered with the select that owns them.
+    aggregate_set* aggregates = nullptr;
+
+    // Set when the select has window functions, view is then
+    // the window_view computing them.
+    window_view* windows = nullptr;
+
     from_t() = default;
-    from_t(parse_tree_node node, table_map_t& tables);
+    from_t(plan_node& node, table_map_t& tables);
 };
 
 #endif
@@ -1,10 +1,13 @@
 #ifndef _LOAD_H
 #define _LOAD_H
 
+#include <algorithm>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "../parser.hpp"
+#include "../shared_tables.hpp"
 #include "../table.hpp"
 
 #include "as.hpp"
@@ -13,6 +16,9 @@
 // Load expects a variadic series of
 // "as" clauses as arguments,
 // i.e. load csv1 as table1, csv2 as table2 ....
+// Each may be followed by SORTED_BY column,
+// i.e. load csv1 as table1 sorted_by TIME,
+// which fails the load if that column isn't sorted.
 
 // Unpackes the argument list.
 // Stores a point back into the table map.
@@ -22,6 +28,7 @@ struct load_t : query_object
 {
     table_map_t* tables;
     std::vector<as_t<identitifer_t>> load_args;
+    std::vector<std::string> sorted_by;
 
     load_t() = default;
     load_t(parse_tree_node& node,
@@ -35,23 +42,32 @@ struct load_t : query_object
 
         for(auto& arg : node.args)
         {
-            if(arg.args.size() != 2)
+            auto* as = &arg;
+            std::string sorted_column;
+            if(arg.token.t == token_t::SORTED_BY)
+            {
+                as = &arg.args[0];
+                sorted_column = identitifer_t(arg.args[1]).id;
+            }
+
+            if(as->token.t != token_t::AS || as->args.size() != 2)
             {
                 std::cerr << "INTERNAL: Not enough args to AS." << std::endl;
                 throw 0;
             }
 
-            load_args.push_back(as_t<identitifer_t>(arg));
+            load_args.push_back(as_t<identitifer_t>(*as));
+            sorted_by.push_back(sorted_column);
         }
         tables = &tables_;
     }
 
     void run() override
     {
-        for(auto& load_arg : load_args)
+        for(unsigned int i = 0; i < load_args.size(); i++)
         {
-            auto csv = load_arg.value.id;
-            auto table_name = load_arg.name;
+            auto csv = load_args[i].value.id;
+            auto table_name = load_args[i].name;
 
             if(tables->find(table_name) != tables->end())
             {
@@ -60,7 +76,27 @@ struct load_t : query_object
                 throw 0;
             }
 
-            tables->emplace(std::make_pair(table_name, std::make_shared<table>(csv)));
+            auto loaded = load_table(csv);
+            if(sorted_by[i] != "")
+            {
+                auto column = std::find(loaded->column_names.begin(),
+                                        loaded->column_names.end(),
+                                        sorted_by[i]) - loaded->column_names.begin();
+                if(column == loaded->width)
+                {
+                    std::cerr << "Could not resolve column " << sorted_by[i]
+                              << " in " << csv << "." << std::endl;
+                    throw 0;
+                }
+                if(!loaded->sorted[column])
+                {
+                    std::cerr << "Column " << sorted_by[i] << " in " << csv
+                              << " is not sorted." << std::endl;
+                    throw 0;
+                }
+            }
+
+            tables->emplace(std::make_pair(table_name, loaded));
         }
     }
 };
@@ -22,15 +22,15 @@ struct on_t
             throw 0;
         }
 
-        node = node.args[0];
-        if(node.token.t != token_t::EQUAL)
+        auto& equal = node.args[0];
+        if(equal.token.t != token_t::EQUAL)
         {
             std::cerr << "Expected EQUALS argument to ON." << std::endl;
             throw 0;
         }
 
-        left_id = identitifer_t(node.args[0]);
-        right_id = identitifer_t(node.args[1]);
+        left_id = identitifer_t(equal.args[0]);
+        right_id = identitifer_t(equal.args[1]);
     }
 };
 
@@ -0,0 +1,1182 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+#include "plan.hpp"
+
+#include "aggregators.hpp"
+#include "cost.hpp"
+#include "identitifer.hpp"
+#include "window.hpp"
+
+int plan_node::find_column(const std::string& column_name)
+{
+    if(name != "")
+    {
+        for(unsigned int i = 0; i < column_names.size(); i++)
+        {
+            if(column_name == name + "." + column_names[i])
+                return i;
+        }
+    }
+
+    for(unsigned int i = 0; i < column_names.size(); i++)
+    {
+        if(column_names[i] == column_name)
+            return i;
+    }
+
+    return -1;
+}
+
+// Joins qualify the columns of each side with it's name.
+static void qualify_columns(plan_node& side, std::vector<std::string>& column_names)
+{
+    for(auto& column_name : side.column_names)
+    {
+        if(side.name != "")
+            column_names.push_back(side.name + "." + column_name);
+        else
+            column_names.push_back(column_name);
+    }
+}
+
+// Output column names, as the selects name them.
+static void name_columns(plan_node& plan, plan_node& source)
+{
+    int column_idx = 0;
+    for(auto& expression : plan.expressions)
+    {
+        if(expression.token.t == token_t::AS)
+        {
+            plan.column_names.push_back(identitifer_t(expression.args[1]).id);
+            column_idx++;
+        }
+        else if(plan.type == plan_node::PROJECT &&
+                expression.token.t == token_t::IDENTITIFER)
+        {
+            plan.column_names.push_back(expression.token.raw_rep);
+            column_idx++;
+        }
+        else if(plan.type == plan_node::PROJECT &&
+                expression.token.t == token_t::SELECT_ALL)
+        {
+            plan.column_names.insert(plan.column_names.end(),
+                                     source.column_names.begin(),
+                                     source.column_names.end());
+            column_idx += plan.column_names.size();
+        }
+        else
+        {
+            std::stringstream stream;
+            stream << "col_" << column_idx;
+            plan.column_names.push_back(stream.str());
+            column_idx++;
+        }
+    }
+}
+
+// Unpack all our possible clauses, checking the validity of each
+// with respect to what we've already processed.
+// Parser constructs the arguments in reverse order.
+static std::unique_ptr<plan_node> select_plan(parse_tree_node& node,
+                                              table_map_t& tables)
+{
+    if(node.args.size() < 2)
+    {
+        std::cerr << "Not enough args to select." << std::endl;
+        throw 0;
+    }
+
+    std::unique_ptr<plan_node> source;
+    limit_t limit;
+    offset_t offset;
+    bool seen_offset = false, seen_limit = false, seen_where = false;
+    parse_tree_node where_node;
+    unsigned int i = 0;
+
+    for(auto& arg : node.args)
+    {
+        switch(arg.token.t)
+        {
+            case token_t::OFFSET:
+            {
+                if(seen_offset || seen_where || seen_limit)
+                {
+                    std::cerr << "Unexpected OFFSET clause." << std::endl;
+                    throw 0;
+                }
+                offset = offset_t(arg);
+                seen_offset = true;
+                break;
+            }
+            case token_t::LIMIT:
+            {
+                if(seen_limit || seen_where)
+                {
+                    std::cerr << "Unexpected LIMIT clause." << std::endl;
+                    throw 0;
+                }
+                limit = limit_t(arg);
+                seen_limit = true;
+                break;
+            }
+            case token_t::WHERE:
+            {
+                if(seen_where)
+                {
+                    std::cerr << "Unexpected WHERE clause." << std::endl;
+                    throw 0;
+                }
+                if(arg.args.size() == 0)
+                {
+                    std::cerr << "No args supplied to WHERE clause." << std::endl;
+                    throw 0;
+                }
+                where_node = arg;
+                seen_where = true;
+                break;
+            }
+            case token_t::FROM:
+            {
+                if(!arg.args.size())
+                {
+                    std::cerr << "INTERNAL: No args to FROM." << std::endl;
+                    throw 0;
+                }
+                if(arg.args.size() != 1)
+                {
+                    std::cerr << "Variadic FROM not supported (1 arg required)" << std::endl;
+                    throw 0;
+                }
+                source = plan_factory(arg.args[0], tables);
+                goto end_loop; // End loop after we process our FROM clause
+            }
+            default:
+            {
+                std::cerr << "Unexpected clause after FROM." << std::endl;
+                throw 0;
+            }
+        }
+        i++;
+    }
+    end_loop:
+    if(i++ == node.args.size())
+    {
+        std::cerr << "No FROM clause seen." << std::endl;
+        throw 0;
+    }
+    if(i == node.args.size())
+    {
+        std::cerr << "No expressions passed to SELECT." << std::endl;
+        throw 0;
+    }
+    if(seen_offset && !seen_limit)
+    {
+        std::cerr << "OFFSET clause without LIMIT clause." << std::endl;
+        throw 0;
+    }
+
+    // Track whether we're doing an aggregate or column select.
+    bool seen_column_selector = false, seen_aggregator = false;
+    std::vector<parse_tree_node> expressions;
+    for(unsigned int j = node.args.size(); j-- > i; )
+    {
+        auto& expression = node.args[j].token.t == token_t::AS ?
+                                node.args[j].args[0] : node.args[j];
+        if(contains_aggregate(expression))
+            seen_aggregator = true;
+        else
+            seen_column_selector = true;
+
+        if(seen_column_selector && seen_aggregator)
+        {
+            std::cerr << "Cannot select on column selection and aggregates." << std::endl;
+            throw 0;
+        }
+
+        expressions.push_back(node.args[j]);
+    }
+
+    // The WHERE clause filters before LIMIT and OFFSET.
+    if(seen_where)
+    {
+        std::unique_ptr<plan_node> filter(new plan_node(plan_node::FILTER));
+        filter->name         = source->name;
+        filter->column_names = source->column_names;
+        filter->predicates.assign(where_node.args.rbegin(), where_node.args.rend());
+        filter->children.push_back(std::move(source));
+        source = std::move(filter);
+    }
+
+    if(seen_limit)
+    {
+        std::unique_ptr<plan_node> limit_plan(new plan_node(plan_node::LIMIT));
+        limit_plan->name         = source->name;
+        limit_plan->column_names = source->column_names;
+        limit_plan->limit        = limit;
+        limit_plan->offset       = offset;
+        limit_plan->children.push_back(std::move(source));
+        source = std::move(limit_plan);
+    }
+
+    std::unique_ptr<plan_node> plan(new plan_node(seen_column_selector ? plan_node::PROJECT
+                                                                       : plan_node::AGGREGATE));
+    plan->expressions = expressions;
+    name_columns(*plan, *source);
+    plan->children.push_back(std::move(source));
+    return plan;
+}
+
+std::unique_ptr<plan_node> plan_factory(parse_tree_node& node, table_map_t& tables)
+{
+    switch(node.token.t)
+    {
+        case token_t::AS:
+        {
+            if(node.args.size() != 2)
+            {
+                std::cerr << "INTERNAL: Not enough args to AS." << std::endl;
+                throw 0;
+            }
+            auto plan = plan_factory(node.args[0], tables);
+            plan->name = identitifer_t(node.args[1]).id;
+            return plan;
+        }
+        case token_t::IDENTITIFER:
+        {
+            auto table = tables.find(node.token.raw_rep);
+            if(table == tables.end())
+            {
+                std::cerr << "Could not resolve table " << node.token.raw_rep << std::endl;
+                throw 0;
+            }
+
+            std::unique_ptr<plan_node> plan(new plan_node(plan_node::SCAN));
+            plan->table_id     = node;
+            plan->name         = node.token.raw_rep;
+            plan->column_names = table->second->column_names;
+            return plan;
+        }
+        case token_t::OUTER_JOIN:
+        case token_t::INNER_JOIN:
+        case token_t::LEFT_JOIN:
+        case token_t::RIGHT_JOIN:
+        {
+            if(node.args.size() != 3)
+            {
+                std::cerr << "Not enough args to " << output_token(node.token)
+                          << ". (perhaps ON required>)" << std::endl;
+                throw 0;
+            }
+
+            std::unique_ptr<plan_node> plan(new plan_node(plan_node::JOIN));
+            plan->join_type = node.token;
+            plan->on        = node.args[0];
+            plan->children.push_back(plan_factory(node.args[2], tables));
+            plan->children.push_back(plan_factory(node.args[1], tables));
+            qualify_columns(*plan->children[0], plan->column_names);
+            qualify_columns(*plan->children[1], plan->column_names);
+            return plan;
+        }
+        case token_t::CROSS_JOIN:
+        {
+            if(node.args.size() != 2)
+            {
+                std::cerr << "INTERNAL: Not enough args to CROSS_JOIN." << std::endl;
+                throw 0;
+            }
+
+            std::unique_ptr<plan_node> plan(new plan_node(plan_node::JOIN));
+            plan->join_type = node.token;
+            plan->children.push_back(plan_factory(node.args[0], tables));
+            plan->children.push_back(plan_factory(node.args[1], tables));
+            qualify_columns(*plan->children[0], plan->column_names);
+            qualify_columns(*plan->children[1], plan->column_names);
+            return plan;
+        }
+        case token_t::SELECT:
+        {
+            return select_plan(node, tables);
+        }
+        default:
+        {
+            std::cerr << "Invalid input: Unexpected argument to FROM. "
+                      << output_token(node.token) << std::endl;
+            throw 0;
+        }
+    }
+}
+
+// Rewrite rules. Each is tried on every node of the plan,
+// returning whether it changed anything.
+typedef bool (*rewrite_rule)(std::unique_ptr<plan_node>& node, table_map_t& tables);
+
+// WHERE a AND b is the same as WHERE a, b,
+// and separate predicates can be moved independently.
+static bool split_conjunctions(std::unique_ptr<plan_node>& node, table_map_t&)
+{
+    if(node->type != plan_node::FILTER)
+        return false;
+
+    bool changed = false;
+    std::vector<parse_tree_node> predicates;
+    for(auto& predicate : node->predicates)
+    {
+        if(predicate.token.t == token_t::AND)
+        {
+            predicates.insert(predicates.end(), predicate.args.begin(), predicate.args.end());
+            changed = true;
+        }
+        else
+        {
+            predicates.push_back(predicate);
+        }
+    }
+
+    node->predicates.swap(predicates);
+    return changed;
+}
+
+static bool merge_filters(std::unique_ptr<plan_node>& node, table_map_t&)
+{
+    if(node->type != plan_node::FILTER ||
+       node->children[0]->type != plan_node::FILTER)
+        return false;
+
+    auto child = std::move(node->children[0]);
+    node->predicates.insert(node->predicates.end(),
+                            child->predicates.begin(),
+                            child->predicates.end());
+    node->children[0] = std::move(child->children[0]);
+    return true;
+}
+
+static bool remove_empty_filters(std::unique_ptr<plan_node>& node, table_map_t&)
+{
+    if(node->type != plan_node::FILTER || node->predicates.size())
+        return false;
+
+    auto child = std::move(node->children[0]);
+    node = std::move(child);
+    return true;
+}
+
+// Columns of plan the expression in node reads.
+// Returns false if any don't resolve.
+static bool find_columns(parse_tree_node& node, plan_node& plan, std::vector<int>& columns)
+{
+    if(node.token.t == token_t::IDENTITIFER)
+    {
+        int column = plan.find_column(node.token.raw_rep);
+        columns.push_back(column);
+        return column >= 0;
+    }
+
+    for(auto& arg : node.args)
+        if(!find_columns(arg, plan, columns))
+            return false;
+    return true;
+}
+
+// Replaces each column of plan read in node with the
+// expression computing it below plan.
+static void replace_columns(parse_tree_node& node, plan_node& plan,
+                            std::vector<parse_tree_node>& replacements)
+{
+    if(node.token.t == token_t::IDENTITIFER)
+    {
+        node = replacements[plan.find_column(node.token.raw_rep)];
+        return;
+    }
+
+    for(auto& arg : node.args)
+        replace_columns(arg, plan, replacements);
+}
+
+// An identifier that resolves to column in plan's output,
+// false if the column can't be named unambiguously.
+static bool column_reference(plan_node& plan, unsigned int column,
+                             parse_tree_node& reference)
+{
+    std::string id = plan.name != "" ? plan.name + "." + plan.column_names[column]
+                                     : plan.column_names[column];
+    if(plan.find_column(id) != (int)column)
+        return false;
+
+    reference = parse_tree_node(parse_tree_node::VALUE, token_t(token_t::IDENTITIFER, id));
+    return true;
+}
+
+// Puts the predicates in a filter directly above node.
+static void add_filter(std::unique_ptr<plan_node>& node,
+                       std::vector<parse_tree_node>& predicates)
+{
+    std::unique_ptr<plan_node> filter(new plan_node(plan_node::FILTER));
+    filter->name         = node->name;
+    filter->column_names = node->column_names;
+    filter->predicates   = predicates;
+    filter->children.push_back(std::move(node));
+    node = std::move(filter);
+}
+
+// True if side of the join is a table with a persistent index on
+// the join column, which the join probes instead of building one.
+static bool persistent_index(plan_node& join, int side, table_map_t& tables)
+{
+    auto& child = *join.children[side];
+    auto& on = join.on;
+    if(child.type != plan_node::SCAN || on.args.size() != 1 || on.args[0].args.size() != 2 ||
+       on.args[0].args[side].token.t != token_t::IDENTITIFER)
+        return false;
+
+    int column = child.find_column(on.args[0].args[side].token.raw_rep);
+    if(column < 0)
+        return false;
+
+    auto index = tables[child.table_id.token.raw_rep]->find_index(column);
+    return index && index->hash.size();
+}
+
+// Predicates reading only one side of a join filter that side before
+// it's loaded and indexed, which for inner and cross joins is either
+// side. A LEFT_JOIN keeps every row of it's left side, so filtering the
+// left early drops the same rows as filtering after. Filtering it's right
+// early would leave left rows unmatched instead of dropping them, so only
+// the left side of a LEFT_JOIN, the right of a RIGHT_JOIN and neither
+// side of an OUTER_JOIN are filtered early.
+// Filtering a table copies it, losing its persistent index, so the
+// side the join would probe keeps its predicates above the join.
+static bool push_filter_into_join(std::unique_ptr<plan_node>& node, table_map_t& tables)
+{
+    if(node->type != plan_node::FILTER ||
+       node->children[0]->type != plan_node::JOIN)
+        return false;
+
+    auto& join = *node->children[0];
+    auto join_type = join.join_type.t;
+    bool can_push[2] = { join_type == token_t::INNER_JOIN || join_type == token_t::CROSS_JOIN ||
+                         join_type == token_t::LEFT_JOIN,
+                         join_type == token_t::INNER_JOIN || join_type == token_t::CROSS_JOIN ||
+                         join_type == token_t::RIGHT_JOIN };
+    if(join_type == token_t::INNER_JOIN)
+    {
+        if(persistent_index(join, 1, tables))
+            can_push[1] = false;
+        else if(persistent_index(join, 0, tables))
+            can_push[0] = false;
+    }
+    unsigned int left_width = join.children[0]->column_names.size();
+
+    std::vector<parse_tree_node> kept, pushed[2];
+    for(auto& predicate : node->predicates)
+    {
+        std::vector<int> columns;
+        if(!find_columns(predicate, join, columns) || !columns.size())
+        {
+            kept.push_back(predicate);
+            continue;
+        }
+
+        int side = columns[0] < (int)left_width ? 0 : 1;
+        bool one_side = can_push[side];
+        std::vector<parse_tree_node> replacements(join.column_names.size());
+        for(auto column : columns)
+        {
+            unsigned int offset = side ? left_width : 0;
+            if((column < (int)left_width ? 0 : 1) != side ||
+               !column_reference(*join.children[side], column - offset, replacements[column]))
+            {
+                one_side = false;
+                break;
+            }
+        }
+
+        if(!one_side)
+        {
+            kept.push_back(predicate);
+            continue;
+        }
+
+        replace_columns(predicate, join, replacements);
+        pushed[side].push_back(predicate);
+    }
+
+    if(!pushed[0].size() && !pushed[1].size())
+        return false;
+
+    for(int side = 0; side < 2; side++)
+        if(pushed[side].size())
+            add_filter(join.children[side], pushed[side]);
+
+    node->predicates.swap(kept);
+    return true;
+}
+
+// Filters on the output of a column select can filter it's input instead,
+// reading the expressions that compute the columns. Not past a LIMIT,
+// or window functions, as they depend on which rows reach them.
+static bool push_filter_into_select(std::unique_ptr<plan_node>& node, table_map_t&)
+{
+    if(node->type != plan_node::FILTER ||
+       node->children[0]->type != plan_node::PROJECT)
+        return false;
+
+    auto& select = *node->children[0];
+    auto& source = *select.children[0];
+    if(source.type == plan_node::LIMIT)
+        return false;
+
+    // Expressions computing each of our columns from the source,
+    // empty if a column can't be named.
+    std::vector<parse_tree_node> replacements;
+    for(auto& expression : select.expressions)
+    {
+        if(contains_window(expression))
+            return false;
+
+        if(expression.token.t == token_t::AS)
+        {
+            replacements.push_back(expression.args[0]);
+        }
+        else if(expression.token.t == token_t::SELECT_ALL)
+        {
+            for(unsigned int i = 0; i < source.column_names.size(); i++)
+            {
+                replacements.push_back(parse_tree_node());
+                column_reference(source, i, replacements.back());
+            }
+        }
+        else
+        {
+            replacements.push_back(expression);
+        }
+    }
+
+    std::vector<parse_tree_node> kept, pushed;
+    for(auto& predicate : node->predicates)
+    {
+        std::vector<int> columns;
+        bool replaceable = find_columns(predicate, select, columns);
+        for(auto column : columns)
+            if(replaceable && replacements[column].a_type == parse_tree_node::EMPTY)
+                replaceable = false;
+
+        if(!replaceable)
+        {
+            kept.push_back(predicate);
+            continue;
+        }
+
+        replace_columns(predicate, select, replacements);
+        pushed.push_back(predicate);
+    }
+
+    if(!pushed.size())
+        return false;
+
+    add_filter(select.children[0], pushed);
+    node->predicates.swap(kept);
+    return true;
+}
+
+static const rewrite_rule rules[] =
+{
+    split_conjunctions,
+    merge_filters,
+    remove_empty_filters,
+    push_filter_into_join,
+    push_filter_into_select,
+};
+
+static bool rewrite(std::unique_ptr<plan_node>& node, table_map_t& tables)
+{
+    bool changed = false;
+    for(auto rule : rules)
+        changed = rule(node, tables) || changed;
+
+    for(auto& child : node->children)
+        changed = rewrite(child, tables) || changed;
+
+    return changed;
+}
+
+// Projection pushdown.
+
+// Joins load each side that isn't a plain table into memory, along with
+// every column. Working down from the output, we find the columns each node's
+// consumers read, and have the sides of joins only carry those.
+
+// Marks the columns of plan read by the expression in node,
+// or all of them if any don't resolve.
+static void need_columns(parse_tree_node& node, plan_node& plan, std::vector<bool>& needed)
+{
+    auto& expression = node.token.t == token_t::AS ? node.args[0] : node;
+
+    std::vector<int> columns;
+    if(expression.token.t == token_t::SELECT_ALL ||
+       !find_columns(expression, plan, columns))
+    {
+        needed.assign(needed.size(), true);
+        return;
+    }
+
+    for(auto column : columns)
+        needed[column] = true;
+}
+
+static parse_tree_node named_expression(parse_tree_node& expression, const std::string& name)
+{
+    return parse_tree_node(token_t(token_t::AS),
+                           std::vector<parse_tree_node>{expression,
+                               parse_tree_node(parse_tree_node::VALUE,
+                                               token_t(token_t::IDENTITIFER, name))});
+}
+
+static bool all_needed(std::vector<bool>& needed)
+{
+    for(auto column : needed)
+        if(!column) return false;
+    return true;
+}
+
+// Puts a column select of the needed columns above node,
+// with the same names. False if they can't all be named.
+static bool narrow_columns(std::unique_ptr<plan_node>& node, std::vector<bool>& needed)
+{
+    std::unique_ptr<plan_node> select(new plan_node(plan_node::PROJECT));
+    for(unsigned int i = 0; i < needed.size(); i++)
+    {
+        if(!needed[i])
+            continue;
+
+        parse_tree_node reference;
+        if(!column_reference(*node, i, reference))
+            return false;
+        select->expressions.push_back(named_expression(reference, node->column_names[i]));
+    }
+
+    select->name = node->name;
+    name_columns(*select, *node);
+    select->children.push_back(std::move(node));
+    node = std::move(select);
+    return true;
+}
+
+// Drops the columns of a column select no one reads. Unnamed columns are
+// given their col_N name, so the rest keep their names. False if we can't
+// name all the columns a SELECT * expands to.
+static bool drop_columns(plan_node& select, std::vector<bool>& needed)
+{
+    auto& source = *select.children[0];
+    std::vector<parse_tree_node> expressions;
+    unsigned int column = 0;
+    for(auto& expression : select.expressions)
+    {
+        if(expression.token.t == token_t::SELECT_ALL)
+        {
+            for(unsigned int i = 0; i < source.column_names.size(); i++, column++)
+            {
+                if(!needed[column])
+                    continue;
+
+                parse_tree_node reference;
+                if(!column_reference(source, i, reference))
+                    return false;
+                expressions.push_back(named_expression(reference, select.column_names[column]));
+            }
+            continue;
+        }
+
+        if(needed[column])
+        {
+            if(expression.token.t == token_t::AS ||
+               expression.token.t == token_t::IDENTITIFER)
+                expressions.push_back(expression);
+            else
+                expressions.push_back(named_expression(expression, select.column_names[column]));
+        }
+        column++;
+    }
+
+    // Keep a column, so we still have rows.
+    if(!expressions.size())
+        return false;
+
+    select.expressions.swap(expressions);
+    return true;
+}
+
+static void prune_columns(std::unique_ptr<plan_node>& node, std::vector<bool> needed)
+{
+    switch(node->type)
+    {
+        case plan_node::SCAN:
+            return;
+        case plan_node::LIMIT:
+        {
+            prune_columns(node->children[0], needed);
+            break;
+        }
+        case plan_node::FILTER:
+        {
+            for(auto& predicate : node->predicates)
+                need_columns(predicate, *node->children[0], needed);
+            prune_columns(node->children[0], needed);
+            break;
+        }
+        case plan_node::PROJECT:
+        case plan_node::AGGREGATE:
+        {
+            if(node->type == plan_node::PROJECT && !all_needed(needed))
+                drop_columns(*node, needed);
+
+            auto& source = *node->children[0];
+            std::vector<bool> source_needed(source.column_names.size());
+            for(auto& expression : node->expressions)
+                need_columns(expression, source, source_needed);
+            prune_columns(node->children[0], source_needed);
+
+            node->column_names.clear();
+            name_columns(*node, *node->children[0]);
+            return;
+        }
+        case plan_node::JOIN:
+        {
+            unsigned int left_width = node->children[0]->column_names.size();
+            std::vector<bool> side_needed[2] =
+            {
+                std::vector<bool>(needed.begin(), needed.begin() + left_width),
+                std::vector<bool>(needed.begin() + left_width, needed.end()),
+            };
+
+            // Each side of the ON clause resolves against it's own side.
+            if(node->join_type.t != token_t::CROSS_JOIN &&
+               node->on.args.size() == 1 && node->on.args[0].args.size() == 2)
+            {
+                need_columns(node->on.args[0].args[0], *node->children[0], side_needed[0]);
+                need_columns(node->on.args[0].args[1], *node->children[1], side_needed[1]);
+            }
+
+            for(int side = 0; side < 2; side++)
+            {
+                auto& child = node->children[side];
+
+                // Plain tables aren't copied, so there's nothing to save.
+                if((child->type == plan_node::FILTER || child->type == plan_node::JOIN) &&
+                   !all_needed(side_needed[side]))
+                {
+                    if(!std::count(side_needed[side].begin(), side_needed[side].end(), true))
+                        side_needed[side][0] = true;
+                    if(narrow_columns(child, side_needed[side]))
+                        side_needed[side].assign(child->column_names.size(), true);
+                }
+
+                prune_columns(child, side_needed[side]);
+            }
+
+            node->column_names.clear();
+            qualify_columns(*node->children[0], node->column_names);
+            qualify_columns(*node->children[1], node->column_names);
+            return;
+        }
+    }
+
+    node->column_names = node->children[0]->column_names;
+}
+
+// Join ordering.
+
+// A cluster of inner joins can be run in any order that only joins
+// groups of tables with an ON clause between them. We estimate the cost
+// of each join from the rows it loads, indexes, probes and outputs, and
+// pick the cheapest order and build sides. By dynamic programming over
+// every connected group for up to max_dp_inputs inputs, otherwise
+// greedily joining the pair with the fewest output rows. Groups are
+// bitmasks of inputs, so clusters of 64 inputs or more keep their order.
+
+static const unsigned int max_dp_inputs = 10;
+
+// ON clause between column left_column of input left
+// and column right_column of input right.
+struct join_edge
+{
+    unsigned int left, left_column;
+    unsigned int right, right_column;
+    double       left_distinct, right_distinct;
+};
+
+// How a group of inputs is joined, and what that costs.
+struct join_choice
+{
+    unsigned long long int left, right;
+    unsigned int           edge;
+    int                    build_side;
+    double                 cost;
+};
+
+struct join_graph
+{
+    // Where each input hangs in the original plan.
+    std::vector<std::unique_ptr<plan_node>*> inputs;
+    std::vector<double>                      rows;
+    std::vector<join_edge>                   edges;
+
+    // The input and column of each of the cluster's output columns.
+    std::vector<std::pair<unsigned int, unsigned int>> columns;
+
+    // input.column, naming each column of each input.
+    std::vector<std::vector<std::string>> ids;
+
+    std::unordered_map<unsigned long long int, join_choice> choices;
+    table_map_t* tables;
+
+    double estimate_rows(unsigned long long int group);
+    double join_cost(unsigned long long int left, unsigned long long int right,
+                     unsigned int edge, int& build_side);
+    bool find_edge(unsigned long long int left, unsigned long long int right,
+                   unsigned int& edge);
+};
+
+// Rows of the inputs, reduced by each ON clause between
+// them assuming the side with fewer keys has all it's keys
+// in the other.
+double join_graph::estimate_rows(unsigned long long int group)
+{
+    double estimate = 1;
+    for(unsigned int i = 0; i < inputs.size(); i++)
+        if(group & (1ULL << i))
+            estimate *= rows[i];
+
+    for(auto& edge : edges)
+        if((group & (1ULL << edge.left)) && (group & (1ULL << edge.right)))
+            estimate /= std::max(edge.left_distinct, edge.right_distinct);
+
+    return estimate;
+}
+
+// Loading a side copies it unless it's a table, building the index
+// is about twice the work of probing it, unless it's a table with
+// a persistent index on the column.
+double join_graph::join_cost(unsigned long long int left, unsigned long long int right,
+                             unsigned int edge, int& build_side)
+{
+    unsigned long long int sides[2] = { left, right };
+    double side_rows[2], build[2], cost = estimate_rows(left | right);
+    for(int side = 0; side < 2; side++)
+    {
+        side_rows[side] = estimate_rows(sides[side]);
+        build[side]     = 2 * side_rows[side];
+
+        if(sides[side] & (sides[side] - 1))
+        {
+            cost += side_rows[side];
+            continue;
+        }
+
+        unsigned int input = edges[edge].left;
+        unsigned int column = edges[edge].left_column;
+        if(!(sides[side] & (1ULL << input)))
+        {
+            input  = edges[edge].right;
+            column = edges[edge].right_column;
+        }
+
+        auto& node = **inputs[input];
+        if(node.type != plan_node::SCAN)
+        {
+            cost += side_rows[side];
+            continue;
+        }
+
+        auto index = (*tables)[node.table_id.token.raw_rep]->find_index(column);
+        if(index && index->hash.size())
+            build[side] = 0;
+    }
+
+    build_side = build[0] + side_rows[1] <= build[1] + side_rows[0] ? 0 : 1;
+    return cost + std::min(build[0] + side_rows[1], build[1] + side_rows[0]);
+}
+
+bool join_graph::find_edge(unsigned long long int left, unsigned long long int right,
+                           unsigned int& edge)
+{
+    for(edge = 0; edge < edges.size(); edge++)
+    {
+        auto left_input  = 1ULL << edges[edge].left;
+        auto right_input = 1ULL << edges[edge].right;
+        if(((left & left_input) && (right & right_input)) ||
+           ((left & right_input) && (right & left_input)))
+            return true;
+    }
+    return false;
+}
+
+static void order_joins(std::unique_ptr<plan_node>& node, table_map_t& tables);
+
+// Finds the inputs and ON clauses of the cluster of inner joins at node.
+// Joins with an alias are inputs, as they qualify their columns.
+// False if an ON clause doesn't resolve.
+static bool collect_joins(std::unique_ptr<plan_node>& node, bool root, join_graph& graph,
+                          std::vector<std::pair<unsigned int, unsigned int>>& columns)
+{
+    if(node->type != plan_node::JOIN || node->join_type.t != token_t::INNER_JOIN ||
+       (!root && node->name != ""))
+    {
+        order_joins(node, *graph.tables);
+
+        unsigned int input = graph.inputs.size();
+        for(unsigned int i = 0; i < node->column_names.size(); i++)
+            columns.push_back(std::make_pair(input, i));
+        graph.inputs.push_back(&node);
+        return true;
+    }
+
+    std::vector<std::pair<unsigned int, unsigned int>> sides[2];
+    if(!collect_joins(node->children[0], false, graph, sides[0]) ||
+       !collect_joins(node->children[1], false, graph, sides[1]))
+        return false;
+
+    auto& on = node->on;
+    if(on.args.size() != 1 || on.args[0].token.t != token_t::EQUAL ||
+       on.args[0].args.size() != 2)
+        return false;
+
+    if(on.args[0].args[0].token.t != token_t::IDENTITIFER ||
+       on.args[0].args[1].token.t != token_t::IDENTITIFER)
+        return false;
+
+    int left_column  = node->children[0]->find_column(on.args[0].args[0].token.raw_rep);
+    int right_column = node->children[1]->find_column(on.args[0].args[1].token.raw_rep);
+    if(left_column < 0 || right_column < 0)
+        return false;
+
+    join_edge edge;
+    edge.left         = sides[0][left_column].first;
+    edge.left_column  = sides[0][left_column].second;
+    edge.right        = sides[1][right_column].first;
+    edge.right_column = sides[1][right_column].second;
+    graph.edges.push_back(edge);
+
+    columns.insert(columns.end(), sides[0].begin(), sides[0].end());
+    columns.insert(columns.end(), sides[1].begin(), sides[1].end());
+    return true;
+}
+
+// We name columns input.column in the joins we build, which needs
+// each input to have a distinct name, and each column to resolve.
+static bool nameable_inputs(join_graph& graph)
+{
+    for(unsigned int i = 0; i < graph.inputs.size(); i++)
+    {
+        auto& input = **graph.inputs[i];
+        if(input.name == "")
+            return false;
+
+        for(unsigned int j = 0; j < i; j++)
+            if((*graph.inputs[j])->name == input.name)
+                return false;
+
+        graph.ids.push_back(std::vector<std::string>());
+        for(unsigned int column = 0; column < input.column_names.size(); column++)
+        {
+            graph.ids[i].push_back(input.name + "." + input.column_names[column]);
+            if(input.find_column(graph.ids[i].back()) != (int)column)
+                return false;
+        }
+    }
+    return true;
+}
+
+static void choose_order_dp(join_graph& graph)
+{
+    unsigned long long int all = (1ULL << graph.inputs.size()) - 1;
+    for(unsigned long long int group = 1; group <= all; group++)
+    {
+        if(!(group & (group - 1)))
+            continue;
+
+        // Left takes the lowest input, so each split is only tried once.
+        unsigned long long int lowest = group & -group;
+        for(auto left = (group - 1) & group; left; left = (left - 1) & group)
+        {
+            auto right = group ^ left;
+            unsigned int edge;
+            if(!(left & lowest) ||
+               ((left & (left - 1)) && !graph.choices.count(left)) ||
+               ((right & (right - 1)) && !graph.choices.count(right)) ||
+               !graph.find_edge(left, right, edge))
+                continue;
+
+            join_choice choice;
+            choice.left  = left;
+            choice.right = right;
+            choice.edge  = edge;
+            choice.cost  = graph.join_cost(left, right, edge, choice.build_side);
+            if(left & (left - 1))
+                choice.cost += graph.choices[left].cost;
+            if(right & (right - 1))
+                choice.cost += graph.choices[right].cost;
+
+            auto found = graph.choices.find(group);
+            if(found == graph.choices.end() || choice.cost < found->second.cost)
+                graph.choices[group] = choice;
+        }
+    }
+}
+
+static void choose_order_greedy(join_graph& graph)
+{
+    std::vector<unsigned long long int> groups;
+    for(unsigned int i = 0; i < graph.inputs.size(); i++)
+        groups.push_back(1ULL << i);
+
+    while(groups.size() > 1)
+    {
+        unsigned int best_left = 0, best_right = 0, edge;
+        double best_rows = -1;
+        for(unsigned int i = 0; i < groups.size(); i++)
+        {
+            for(unsigned int j = i + 1; j < groups.size(); j++)
+            {
+                if(!graph.find_edge(groups[i], groups[j], edge))
+                    continue;
+
+                double rows = graph.estimate_rows(groups[i] | groups[j]);
+                if(best_rows < 0 || rows < best_rows)
+                {
+                    best_rows  = rows;
+                    best_left  = i;
+                    best_right = j;
+                }
+            }
+        }
+
+        join_choice choice;
+        choice.left  = groups[best_left];
+        choice.right = groups[best_right];
+        graph.find_edge(choice.left, choice.right, choice.edge);
+        choice.cost  = graph.join_cost(choice.left, choice.right,
+                                       choice.edge, choice.build_side);
+        graph.choices[choice.left | choice.right] = choice;
+
+        groups[best_left] |= groups[best_right];
+        groups.erase(groups.begin() + best_right);
+    }
+}
+
+static parse_tree_node column_id(join_graph& graph, unsigned int input, unsigned int column)
+{
+    return parse_tree_node(parse_tree_node::VALUE,
+                           token_t(token_t::IDENTITIFER, graph.ids[input][column]));
+}
+
+// Builds the joins of the group as chosen, appending the
+// input and column of each of their output columns.
+static std::unique_ptr<plan_node> build_joins(join_graph& graph, unsigned long long int group,
+                                              std::vector<std::pair<unsigned int, unsigned int>>& columns)
+{
+    if(!(group & (group - 1)))
+    {
+        unsigned int input = 0;
+        while(!(group & (1ULL << input))) input++;
+
+        auto node = std::move(*graph.inputs[input]);
+        for(unsigned int i = 0; i < node->column_names.size(); i++)
+            columns.push_back(std::make_pair(input, i));
+        return node;
+    }
+
+    auto choice = graph.choices[group];
+    auto& edge  = graph.edges[choice.edge];
+
+    std::unique_ptr<plan_node> join(new plan_node(plan_node::JOIN));
+    join->join_type  = token_t(token_t::INNER_JOIN);
+    join->build_side = choice.build_side;
+    join->children.push_back(build_joins(graph, choice.left, columns));
+    join->children.push_back(build_joins(graph, choice.right, columns));
+    qualify_columns(*join->children[0], join->column_names);
+    qualify_columns(*join->children[1], join->column_names);
+
+    auto left  = column_id(graph, edge.left, edge.left_column);
+    auto right = column_id(graph, edge.right, edge.right_column);
+    if(!(choice.left & (1ULL << edge.left)))
+        std::swap(left, right);
+
+    join->on = parse_tree_node(token_t(token_t::ON), std::vector<parse_tree_node>{
+                    parse_tree_node(token_t(token_t::EQUAL),
+                                    std::vector<parse_tree_node>{left, right})});
+    return join;
+}
+
+// Reorders the cluster of inner joins at node.
+static void reorder_joins(std::unique_ptr<plan_node>& node, table_map_t& tables)
+{
+    join_graph graph;
+    graph.tables = &tables;
+    if(!collect_joins(node, true, graph, graph.columns) ||
+       graph.inputs.size() >= 64 || !nameable_inputs(graph))
+        return;
+
+    for(auto input : graph.inputs)
+        graph.rows.push_back(std::max(estimate_rows(**input, tables), 1.0));
+    for(auto& edge : graph.edges)
+    {
+        edge.left_distinct  = estimate_distinct(**graph.inputs[edge.left],
+                                                edge.left_column, tables);
+        edge.right_distinct = estimate_distinct(**graph.inputs[edge.right],
+                                                edge.right_column, tables);
+    }
+
+    if(graph.inputs.size() <= max_dp_inputs)
+        choose_order_dp(graph);
+    else
+        choose_order_greedy(graph);
+
+    auto name         = node->name;
+    auto column_names = node->column_names;
+    std::vector<std::pair<unsigned int, unsigned int>> columns;
+    auto joins = build_joins(graph, (1ULL << graph.inputs.size()) - 1, columns);
+
+    if(columns == graph.columns)
+    {
+        joins->name = name;
+        node = std::move(joins);
+        return;
+    }
+
+    // Put the columns back in the order they were asked for.
+    std::unique_ptr<plan_node> select(new plan_node(plan_node::PROJECT));
+    for(unsigned int i = 0; i < graph.columns.size(); i++)
+    {
+        auto id = column_id(graph, graph.columns[i].first, graph.columns[i].second);
+        select->expressions.push_back(named_expression(id, column_names[i]));
+    }
+    select->name         = name;
+    select->column_names = column_names;
+    select->children.push_back(std::move(joins));
+    node = std::move(select);
+}
+
+static void order_joins(std::unique_ptr<plan_node>& node, table_map_t& tables)
+{
+    if(node->type == plan_node::JOIN && node->join_type.t == token_t::INNER_JOIN)
+    {
+        reorder_joins(node, tables);
+        return;
+    }
+
+    for(auto& child : node->children)
+        order_joins(child, tables);
+}
+
+void optimize(std::unique_ptr<plan_node>& plan, table_map_t& tables)
+{
+    while(rewrite(plan, tables));
+
+    order_joins(plan, tables);
+
+    prune_columns(plan, std::vector<bool>(plan->column_names.size(), true));
+}
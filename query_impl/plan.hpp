@@ -0,0 +1,101 @@
+#ifndef _PLAN_H
+#define _PLAN_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../parser.hpp"
+#include "../table.hpp"
+
+#include "limit.hpp"
+#include "offset.hpp"
+
+// Logical query plan.
+
+// A SELECT is first built into a tree of plan nodes from the parse tree,
+// then rewritten by the optimizer, and finally instantiated as views
+// by select_factory and view_factory.
+
+// Measured for each node by EXPLAIN ANALYZE, times in ms and
+// including the time of the nodes below.
+struct plan_profile
+{
+    // Rows are always counted, but reading the clock for every
+    // row is left to EXPLAIN ANALYZE.
+    bool timed = true;
+
+    // Constructing the view, which is when joins load their sides
+    // and build their index, and when unbucketed aggregates run.
+    double build_time = 0;
+
+    // Producing rows, or loading them all for a join.
+    double run_time = 0;
+    unsigned long long int rows = 0;
+    unsigned long long int bytes_materialized = 0;
+
+    // JOIN, the side indexed and the number of keys in the index.
+    int  index_side = -1;
+    bool persistent_index = false;
+    unsigned long long int index_keys = 0;
+};
+
+// Expressions are kept as parse tree nodes, and only compiled
+// once we know the view they'll run over.
+struct plan_node
+{
+    enum plan_type
+    {
+        SCAN,       // Loaded table
+        FILTER,     // Rows passing all the predicates
+        PROJECT,    // Column select
+        AGGREGATE,  // Aggregate select
+        JOIN,       // Join of children[0] and children[1]
+        LIMIT,      // LIMIT and OFFSET
+    };
+
+    plan_type type;
+
+    // Our output columns, and the name they can be qualified with.
+    std::string              name;
+    std::vector<std::string> column_names;
+
+    std::vector<std::unique_ptr<plan_node>> children;
+
+    // SCAN
+    parse_tree_node table_id;
+
+    // FILTER, as a conjunction
+    std::vector<parse_tree_node> predicates;
+
+    // PROJECT and AGGREGATE, in output order
+    std::vector<parse_tree_node> expressions;
+
+    // JOIN, build_side is the side to index,
+    // or -1 to pick the smaller once they're loaded.
+    token_t         join_type;
+    parse_tree_node on;
+    int             build_side = -1;
+
+    // LIMIT
+    limit_t  limit;
+    offset_t offset;
+
+    // Set for EXPLAIN ANALYZE, views of nodes with a profile
+    // are wrapped to measure them.
+    std::shared_ptr<plan_profile> profile;
+
+    plan_node(plan_type type_) : type(type_) {};
+
+    // Index of the column, as table_view::resolve_column
+    // would find it, or -1 if it doesn't resolve.
+    int find_column(const std::string& column_name);
+};
+
+// Builds the logical plan of a SELECT, or anything we can select FROM.
+std::unique_ptr<plan_node> plan_factory(parse_tree_node& node, table_map_t& tables);
+
+// Applies the rewrite rules until none of them apply.
+void optimize(std::unique_ptr<plan_node>& plan, table_map_t& tables);
+
+#endif
@@ -1,8 +1,15 @@
 #ifndef _QUERY_OBJECT_H
 #define _QUERY_OBJECT_H
 
+#include <memory>
+
+struct plan_node;
+
 struct query_object
 {
+    // Optimized plan a SELECT runs, kept for the slow query log.
+    std::shared_ptr<plan_node> plan;
+
     virtual void run() = 0;
     virtual ~query_object() = default;
 };
@@ -1,13 +1,19 @@
+#include <algorithm>
+#include <climits>
 #include <iostream>
 #include <sstream>
 #include <stack>
 
 #include "select.hpp"
+#include "../scheduler.hpp"
+#include "../trace.hpp"
 #include "../util.hpp"
 
 #include "aggregators.hpp"
 #include "as.hpp"
 #include "expression.hpp"
+#include "plan.hpp"
+#include "window.hpp"
 
 // Column select only take expressions in as
 // our output columns. Iterates over the
@@ -93,28 +99,47 @@ struct column_select : select_t
 
 // Aggregate selects also define a table view,
 // but only 1 row high, with the row being the
-// values of the accumulators
+// values of expressions over the accumulators.
+// All aggregators share one aggregate_set, so their
+// inputs are only evaluated once per row.
+
+// If grouped by a time_bucket, there is instead a row
+// per bucket. Input must be ordered on the bucketed
+// expression, so each bucket is aggregated as we stream
+// through it, and only one is held at a time. LIMIT and
+// OFFSET then count buckets, not the rows going into them.
+static const unsigned int aggregate_morsel_rows = 1 << 16;
+
 struct aggregate_select : select_t
 {
-    std::vector<std::unique_ptr<aggregator_t>> columns;
+    aggregate_set aggregates;
+    std::vector<std::unique_ptr<expression_t>> columns;
     bool visited = false;
+    limit_t  bucket_limit;
+    offset_t bucket_offset;
 
     aggregate_select(from_t& from,
                      parse_tree_node& where_node,
                      limit_t& limit,
                      offset_t& offset,
-                     std::stack<parse_tree_node>&expression_stack) :
-                                select_t(from, where_node, limit, offset)
+                     std::stack<parse_tree_node>&expression_stack,
+                     limit_t bucket_limit_ = limit_t(),
+                     offset_t bucket_offset_ = offset_t()) :
+                                select_t(from, where_node, limit, offset),
+                                bucket_limit(bucket_limit_), bucket_offset(bucket_offset_)
     {
+        from_t aggregate_from = from;
+        aggregate_from.aggregates = &aggregates;
+
         int column_idx = 0;
         while(!expression_stack.empty())
         {
             parse_tree_node arg = pop_top(expression_stack);
             if(arg.token.t == token_t::AS)
             {
-                as_t<aggregator_container> named_aggregator(arg, from);
-                column_names.push_back(named_aggregator.name);
-                columns.emplace_back(std::move(named_aggregator.value.aggregator));
+                as_t<expression_container> named_expression(arg, aggregate_from);
+                column_names.push_back(named_expression.name);
+                columns.emplace_back(std::move(named_expression.value.expression));
                 column_types.push_back(columns.back()->return_type);
                 column_idx++;
             }
@@ -122,35 +147,135 @@ struct aggregate_select : select_t
             {
                 std::stringstream stream;
                 stream << "col_" << column_idx;
-                columns.emplace_back(aggregator_factory(arg, from));
+                columns.emplace_back(expression_factory(arg, aggregate_from));
                 column_names.push_back(stream.str());
                 column_types.push_back(columns.back()->return_type);
                 column_idx++;
             }
         }
 
+        if(aggregates.bucket)
+        {
+            next_bucket();
+            for(; bucket_offset.offset > 0 && !visited; bucket_offset.offset--)
+                next_bucket();
+            return;
+        }
+
         // Iterate over ourself, calls our aggregator expressions
+        trace_span span("aggregate");
+        if(limit.limit != LONG_MAX || offset.offset || !accumulate_morsels(where_node))
+        {
+            while(!it.empty())
+            {
+                aggregates.accumulate();
+                it.advance_row();
+            }
+        }
+        aggregates.finalize();
+    }
+
+    // Unbucketed aggregates straight over a scan are accumulated a morsel
+    // of rows at a time on the scheduler, each morsel with it's own scan,
+    // WHERE and aggregates, then merged in row order. Morsels are the same
+    // however many threads there are, so float sums don't depend on it.
+    struct aggregate_morsel
+    {
+        std::shared_ptr<table_iterator> scan;
+        where_t                         where;
+        std::unique_ptr<aggregate_set>  aggregates;
+    };
+
+    bool accumulate_morsels(parse_tree_node& where_node)
+    {
+        auto* scan = dynamic_cast<table_iterator*>(it.from.view.get());
+        if(!scan || scan->use_index_rows || !aggregates.mergeable() ||
+           scan->end_row - scan->begin_row <= aggregate_morsel_rows)
+            return false;
+
+        // Compiled here, only accumulating runs in parallel.
+        std::vector<std::unique_ptr<aggregate_morsel>> morsels;
+        for(unsigned int begin = scan->begin_row; begin < scan->end_row; begin += aggregate_morsel_rows)
+        {
+            std::unique_ptr<aggregate_morsel> morsel(new aggregate_morsel());
+            morsel->scan = std::make_shared<table_iterator>(*scan);
+            morsel->scan->begin_row = morsel->scan->current_row = begin;
+            morsel->scan->end_row   = std::min(begin + aggregate_morsel_rows, scan->end_row);
+
+            from_t morsel_from = it.from;
+            morsel_from.view   = morsel->scan;
+            morsel->where      = where_t(where_node, morsel_from);
+            morsel->aggregates = aggregates.partial(morsel_from);
+            morsels.push_back(std::move(morsel));
+        }
+
+        parallel_for(morsels.size(), 1, [&](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; i++)
+            {
+                auto& morsel = *morsels[i];
+                while(!morsel.scan->empty())
+                {
+                    if(morsel.where.filter())
+                        morsel.aggregates->accumulate();
+                    morsel.scan->advance_row();
+                }
+            }
+        });
+
+        for(auto& morsel : morsels)
+            aggregates.merge(*morsel->aggregates);
+        return true;
+    }
+
+    // Aggregate all the rows in the bucket of the current row.
+    void next_bucket()
+    {
+        if(it.empty())
+        {
+            visited = true;
+            return;
+        }
+
+        long long int start = aggregates.current_bucket();
+        aggregates.reset();
         while(!it.empty())
         {
-            for(auto& column : columns)
-                column->accumulate();
+            long long int bucket = aggregates.current_bucket();
+            if(bucket < start)
+            {
+                std::cerr << "Input to time_bucket is not ordered." << std::endl;
+                throw 0;
+            }
+            if(bucket != start)
+                break;
+
+            aggregates.accumulate();
             it.advance_row();
         }
+        aggregates.finalize();
+        aggregates.bucket_value = start;
     }
 
     cell access_column(unsigned int i) override
     {
-        return columns[i]->value();
+        return columns[i]->call();
     }
 
     void advance_row() override
     {
-        visited = true;
+        if(aggregates.bucket)
+        {
+            bucket_limit.limit--;
+            next_bucket();
+        }
+        else
+            visited = true;
     }
 
     bool empty() override
     {
-        return visited;
+        return visited || !bucket_limit.limit;
     }
 
     unsigned int width() override
@@ -158,138 +283,94 @@ struct aggregate_select : select_t
         return columns.size();
     }
 
+    // Speculative when bucketed
     unsigned int height() override
     {
-        return 1;
+        return aggregates.bucket ? it.height() : 1;
     }
 };
 
-// Logic for constructing a select is somewhat involved,
-// and the type of select we're doing isn't known until
-// we see the expressions that are our generating the columns.
-// Thus we need a factory method that calls the appropriate constructor.
-// Parser constructs the arguments in reverse order.
-std::unique_ptr<select_t> select_factory(parse_tree_node& node,
+// Whether an expression groups by time_bucket, see aggregate_set::accessor.
+static bool uses_time_bucket(parse_tree_node& node)
+{
+    if(node.token.t == token_t::FUNCTION &&
+       (node.token.raw_rep == "time_bucket" || node.token.raw_rep == "TIME_BUCKET"))
+        return true;
+
+    for(auto& arg : node.args)
+        if(uses_time_bucket(arg))
+            return true;
+    return false;
+}
+
+// The type of select we're doing is decided by the plan,
+// a factory method calls the appropriate constructor.
+
+// Selects take over the LIMIT and FILTER directly beneath
+// them in the plan, and iterate over the view of the rest.
+std::unique_ptr<select_t> select_factory(plan_node& node,
                                          table_map_t& tables)
 {
-    if(node.args.size() < 2)
-    {
-        std::cerr << "Not enough args to select." << std::endl;
-        throw 0;
-    }
+    auto* source = node.children[0].get();
 
-    from_t from;
     limit_t limit;
     offset_t offset;
-    bool seen_offset = false, seen_limit = false, seen_where = false;
-    parse_tree_node where_node;
-    unsigned int i = 0;
-
-    // Unpack all our possible clauses,
-    // Check the validity of each clause with respect to what we've
-    // already processed
-    for(auto& arg : node.args)
-    {
-        switch(arg.token.t)
-        {
-            case token_t::OFFSET:
-            {
-                if(seen_offset || seen_where || seen_limit)
-                {
-                    std::cerr << "Unexpected OFFSET clause." << std::endl;
-                    throw 0;
-                }
-                offset = offset_t(arg);
-                seen_offset = true;
-                break;
-            }
-            case token_t::LIMIT:
-            {
-                if(seen_limit || seen_where)
-                {
-                    std::cerr << "Unexpected LIMIT clause." << std::endl;
-                    throw 0;
-                }
-                limit = limit_t(arg);
-                seen_limit = true;
-                break;
-            }
-            case token_t::WHERE:
-            {
-                if(seen_where)
-                {
-                    std::cerr << "Unexpected WHERE clause." << std::endl;
-                    throw 0;
-                }
-                // Defer processing of where until we have a FROM.
-                where_node = arg;
-                seen_where = true;
-                break;
-            }
-            case token_t::FROM:
-            {
-                from = from_t(arg, tables);
-                goto end_loop; // End loop after we process our FROM clause
-            }
-            default:
-            {
-                std::cerr << "Unexpected clause after FROM." << std::endl;
-                throw 0;
-            }
-        }
-        i++;
-    }
-    end_loop:
-    if(i++ == node.args.size())
-    {
-        std::cerr << "No FROM clause seen." << std::endl;
-        throw 0;
-    }
-    if(i == node.args.size())
+    if(source->type == plan_node::LIMIT)
     {
-        std::cerr << "No expressions passed to SELECT." << std::endl;
-        throw 0;
+        limit  = source->limit;
+        offset = source->offset;
+        source = source->children[0].get();
     }
-    if(seen_offset && !seen_limit)
+
+    parse_tree_node where_node;
+    if(source->type == plan_node::FILTER)
     {
-        std::cerr << "OFFSET clause without LIMIT clause." << std::endl;
-        throw 0;
+        where_node = parse_tree_node(token_t(token_t::WHERE), source->predicates);
+        source     = source->children[0].get();
     }
 
-    // Preprocess our column expression arguments.
-    // Track whether we're doing an aggregate or column select
-    // Arguments are in reverse order, so push them onto a stack
-    // So we can processing them in order.
-    bool seen_column_selector = false, seen_aggregator = false;
+    from_t from(*source, tables);
+
+    // Push our column expressions onto a stack,
+    // so they're processed in order.
     std::stack<parse_tree_node> expression_stack;
-    while(i < node.args.size())
+    std::vector<parse_tree_node> window_nodes;
+    for(auto expression = node.expressions.rbegin();
+        expression != node.expressions.rend(); expression++)
     {
-        if(node.args[i].token.t == token_t::FUNCTION)
-            seen_aggregator = true;
-        else if(node.args[i].token.t == token_t::AS)
-        {
-            if(node.args[i].args[0].token.t == token_t::FUNCTION)
-                seen_aggregator = true;
-            else
-                seen_column_selector = true;
-        }
-        else
-            seen_column_selector = true;
-
-        if(seen_column_selector && seen_aggregator)
-        {
-            std::cerr << "Cannot select on column selection and aggregates." << std::endl;
-            throw 0;
-        }
+        collect_windows(*expression, window_nodes);
+        expression_stack.push(*expression);
+    }
 
-        expression_stack.push(node.args[i++]);
+    // Window functions are computed over the filtered rows before
+    // OFFSET and LIMIT, so the window_view takes over the WHERE clause,
+    // and becomes the view the select's expressions are compiled against.
+    if(window_nodes.size())
+    {
+        auto windows = std::make_shared<window_view>(from, where_node, window_nodes);
+        from.view    = windows;
+        from.windows = windows.get();
+        where_node   = parse_tree_node();
     }
 
     // Dispath to appropciate select subtype
-    if(seen_column_selector)
+    if(node.type == plan_node::PROJECT)
         return std::unique_ptr<select_t>(
             new column_select(from, where_node, limit, offset, expression_stack));
-    else
-        return std::unique_ptr<select_t>(
-            new aggregate_select(from, where_node, limit, offset, expression_stack));
+
+    // Bucketed, the LIMIT and OFFSET are of the buckets we emit,
+    // so every row of the input is read.
+    for(auto& expression : node.expressions)
+    {
+        if(uses_time_bucket(expression))
+        {
+            limit_t  all_rows;
+            offset_t no_rows;
+            return std::unique_ptr<select_t>(
+                new aggregate_select(from, where_node, all_rows, no_rows, expression_stack,
+                                     limit, offset));
+        }
+    }
+    return std::unique_ptr<select_t>(
+        new aggregate_select(from, where_node, limit, offset, expression_stack));
 }
@@ -1,18 +1,23 @@
 #ifndef _SELECT_H
 #define _SELECT_H
 
-#include <iomanip>
 #include <memory>
 #include <string>
 
 #include "../output_format.hpp"
 #include "../parser.hpp"
+#include "../columnar_output.hpp"
+#include "../csv_output.hpp"
+#include "../result_writer.hpp"
 #include "../table.hpp"
+#include "../metrics.hpp"
 #include "../table_views.hpp"
+#include "../trace.hpp"
 
 #include "from.hpp"
 #include "limit.hpp"
 #include "offset.hpp"
+#include "plan.hpp"
 #include "query_object.hpp"
 #include "where.hpp"
 
@@ -102,65 +107,51 @@ struct select_t : query_object, table_view
 
     void run() override
     {
+        trace_span span("output");
+        unsigned long long int rows = 0;
+        result_writer out;
+        auto num_columns = width();
         if(out_format == format_t::FORMATTED)
         {
-            auto num_columns = width();
             for(unsigned int i = 0 ; i < num_columns; i++)
             {
-                std::cout << std::setw(10) << column_names[i];
-                if(i != num_columns - 1) std::cout << " | ";
+                out.write(column_names[i], 10);
+                if(i != num_columns - 1) out.write(" | ", 3);
             }
-            std::cout << std::endl;
+            out.put('\n');
 
             for(unsigned int i = 0 ; i < num_columns; i++)
             {
-                std::cout << "----------";
-                if(i != num_columns - 1) std::cout << "-+-";
+                out.write("----------", 10);
+                if(i != num_columns - 1) out.write("-+-", 3);
             }
-            std::cout << std::endl;
+            out.put('\n');
 
             while(!empty())
             {
                 for(unsigned int i = 0; i < num_columns; i++)
                 {
-                    cell value = access_column(i);
-                    if(column_types[i] == cell_type::INT)
-                        std::cout << std::setw(10) << value.i;
-                    else
-                        std::cout << std::setw(10) << value.d;
-                    if(i != num_columns - 1) std::cout  << " | ";
+                    out.write_cell(access_column(i), column_types[i], 10);
+                    if(i != num_columns - 1) out.write(" | ", 3);
                 }
-                std::cout << std::endl;
-                advance_row();
-            }
-        }
-        else if (out_format == format_t::CSV)
-        {
-            auto num_columns = width();
-            for(unsigned int i = 0 ; i < num_columns; i++)
-            {
-                std::cout << column_names[i];
-                if(i != num_columns - 1) std::cout << ",";
-            }
-            std::cout << std::endl;
-
-            while(!empty())
-            {
-                for(unsigned int i = 0; i < num_columns; i++)
-                {
-                    cell value = access_column(i);
-                    if(column_types[i] == cell_type::INT)
-                        std::cout << value.i;
-                    else
-                        std::cout << value.d;
-                    if(i != num_columns - 1) std::cout  << ",";
-                }
-                std::cout << std::endl;
+                out.put('\n');
                 advance_row();
+                rows++;
             }
         }
+        else if(out_format == format_t::CSV)
+            rows = write_csv(*this, out);
+        else if(out_format == format_t::ARROW)
+            rows = write_arrow(*this, out);
+        else if(out_format == format_t::RAW)
+            rows = write_raw_columns(*this, out);
+        out.flush();
+
+        metrics.rows_emitted += rows;
+        if(plan && plan->profile)
+            plan->profile->rows = rows;
     }
 };
 
-std::unique_ptr<select_t> select_factory(parse_tree_node&, table_map_t&);
+std::unique_ptr<select_t> select_factory(plan_node&, table_map_t&);
 #endif
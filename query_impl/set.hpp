@@ -0,0 +1,66 @@
+#ifndef _SET_H
+#define _SET_H
+
+#include <iostream>
+#include <string>
+
+#include "../parser.hpp"
+#include "../query_limits.hpp"
+
+#include "identitifer.hpp"
+#include "query_object.hpp"
+
+// Changes a setting of the session, i.e.
+// SET statement_timeout = 5000
+// SET memory_limit = 1000000000
+// See query_limits.hpp, 0 turns a limit off.
+struct set_t : query_object
+{
+    std::string name;
+    double      value;
+
+    set_t() = default;
+    set_t(parse_tree_node& node)
+    {
+        if(node.args.size() != 1 || node.args[0].token.t != token_t::EQUAL ||
+           node.args[0].args.size() != 2)
+        {
+            std::cerr << "SET expects a setting = value." << std::endl;
+            throw 0;
+        }
+
+        name = identitifer_t(node.args[0].args[0]).id;
+        auto& literal = node.args[0].args[1].token;
+        if(literal.t == token_t::INT_LITERAL)
+            value = literal.value.i;
+        else if(literal.t == token_t::FLOAT_LITERAL)
+            value = literal.value.d;
+        else
+        {
+            std::cerr << "Non-numeric value passed to SET." << std::endl;
+            throw 0;
+        }
+
+        if(value < 0)
+        {
+            std::cerr << "Negative value passed to SET." << std::endl;
+            throw 0;
+        }
+    }
+
+    void run() override
+    {
+        if(name == "statement_timeout")
+            limits.statement_timeout = value;
+        else if(name == "memory_limit")
+            limits.memory_limit = value;
+        else
+        {
+            std::cerr << "Unknown setting " << name
+                      << ", expected statement_timeout or memory_limit." << std::endl;
+            throw 0;
+        }
+    }
+};
+
+#endif
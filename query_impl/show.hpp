@@ -3,17 +3,20 @@
 
 #include <iostream>
 
+#include "../metrics.hpp"
 #include "../parser.hpp"
 #include "../table.hpp"
 
 #include "query_object.hpp"
 
-// Only show TABLES is implemented.
+// SHOW TABLES or SHOW STATS.
 // Takes a pointer to the table list,
-// and lists all the keys.
+// and lists all the keys, or shows the
+// engine's metrics.
 struct show_t : query_object
 {
     table_map_t* tables;
+    bool stats;
 
     show_t() = default;
     show_t(parse_tree_node& node,
@@ -25,17 +28,25 @@ struct show_t : query_object
             throw 0;
         }
 
-        if(node.args.size() != 1 || node.args[0].token.t != token_t::TABLES)
+        if(node.args.size() != 1 || (node.args[0].token.t != token_t::TABLES &&
+                                     node.args[0].token.t != token_t::STATS))
         {
-            std::cerr << "Only SHOW TABLES implemented." << std::endl;
+            std::cerr << "Only SHOW TABLES and SHOW STATS implemented." << std::endl;
             throw 0;
         }
 
+        stats  = node.args[0].token.t == token_t::STATS;
         tables = &tables_;
     }
 
     void run() override
     {
+        if(stats)
+        {
+            metrics.show(*tables);
+            return;
+        }
+
         std::cout << std::endl;
         if(tables->size() == 0)
         {
@@ -1,6 +1,8 @@
 #ifndef _WHERE_H
 #define _WHERE_H
 
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include "../parser.hpp"
@@ -31,9 +33,75 @@ struct where_t
 
             for(auto& arg : node.args)
                 filters.emplace_back(boolean_factory(arg, from));
+
+            // Let the view skip blocks of rows that can't pass.
+            std::vector<zone_predicate> predicates;
+            for(auto& arg : node.args)
+                collect_zone_predicates(arg, from, predicates);
+            if(predicates.size())
+                from.view->prune_rows(predicates);
         }
     }
 
+    // Finds comparisons of a column against a literal in
+    // the conjunction of filters, i.e. TIME > 5, PRICE < 10.01.
+    void collect_zone_predicates(parse_tree_node& node,
+                                 from_t& from,
+                                 std::vector<zone_predicate>& predicates)
+    {
+        if(node.token.t == token_t::AND)
+        {
+            for(auto& arg : node.args)
+                collect_zone_predicates(arg, from, predicates);
+            return;
+        }
+
+        zone_predicate predicate;
+        switch(node.token.t)
+        {
+            case token_t::LT:    predicate.op = zone_predicate::LESS;          break;
+            case token_t::LTEQ:  predicate.op = zone_predicate::LESS_EQUAL;    break;
+            case token_t::GT:    predicate.op = zone_predicate::GREATER;       break;
+            case token_t::GTEQ:  predicate.op = zone_predicate::GREATER_EQUAL; break;
+            case token_t::EQUAL: predicate.op = zone_predicate::EQUAL;         break;
+            default: return;
+        }
+
+        // Flip literal OP column around to column OP literal
+        auto* column  = &node.args[0];
+        auto* literal = &node.args[1];
+        if(literal->token.t == token_t::IDENTITIFER)
+        {
+            std::swap(column, literal);
+            switch(predicate.op)
+            {
+                case zone_predicate::LESS:          predicate.op = zone_predicate::GREATER;       break;
+                case zone_predicate::LESS_EQUAL:    predicate.op = zone_predicate::GREATER_EQUAL; break;
+                case zone_predicate::GREATER:       predicate.op = zone_predicate::LESS;          break;
+                case zone_predicate::GREATER_EQUAL: predicate.op = zone_predicate::LESS_EQUAL;    break;
+                default: break;
+            }
+        }
+
+        if(column->token.t != token_t::IDENTITIFER ||
+           (literal->token.t != token_t::INT_LITERAL &&
+            literal->token.t != token_t::FLOAT_LITERAL))
+            return;
+
+        predicate.column     = from.view->resolve_column(column->token.raw_rep);
+        predicate.value      = literal->token.value;
+        predicate.value_type = literal->token.t == token_t::INT_LITERAL ?
+                                    cell_type::INT : cell_type::FLOAT;
+
+        // Floating point equality is approximate
+        if(predicate.op == zone_predicate::EQUAL &&
+           (predicate.value_type != cell_type::INT ||
+            from.view->column_types[predicate.column] != cell_type::INT))
+            return;
+
+        predicates.push_back(predicate);
+    }
+
     bool filter()
     {
         for(auto& filter : filters)
@@ -42,4 +110,57 @@ struct where_t
     }
 };
 
+// View of the rows of another view that pass a WHERE clause,
+// for filters the optimizer placed outside of a select.
+struct filter_view : table_view
+{
+    from_t from;
+    where_t where;
+
+    filter_view(from_t& from_,
+                parse_tree_node& where_node) : table_view(), from(from_),
+                                               where(where_node, from)
+    {
+        name         = from.view->name;
+        column_names = from.view->column_names;
+        column_types = from.view->column_types;
+
+        while(!from.view->empty() && !where.filter())
+            from.view->advance_row();
+    }
+
+    cell access_column(unsigned int i) override
+    {
+        return from.view->access_column(i);
+    }
+
+    void advance_row() override
+    {
+        from.view->advance_row();
+        while(!from.view->empty() && !where.filter())
+            from.view->advance_row();
+    }
+
+    bool empty() override
+    {
+        return from.view->empty();
+    }
+
+    unsigned int width() override
+    {
+        return from.view->width();
+    }
+
+    // Speculative
+    unsigned int height() override
+    {
+        return from.view->height();
+    }
+
+    std::shared_ptr<table_iterator> load() override
+    {
+        return std::make_shared<table_iterator>(*this);
+    }
+};
+
 #endif
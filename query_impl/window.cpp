@@ -0,0 +1,439 @@
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <utility>
+
+#include "../query_limits.hpp"
+
+#include "window.hpp"
+
+// Sum and average, over either the whole partition so far,
+// or a sliding frame. Sliding frames keep a ring buffer of
+// the frame, and subtract values as they leave it.
+template<typename T>
+struct sum_state : window_state
+{
+    std::vector<T> frame;
+    unsigned int next;
+    unsigned long long int seen;
+    T sum;
+    bool average;
+
+    sum_state(unsigned int rows, bool average_) : frame(rows), next(0),
+                                                  seen(0), sum(0), average(average_) {};
+
+    cell push(const cell& value) override
+    {
+        T val = *(const T*)&value;
+        if(frame.size())
+        {
+            if(seen >= frame.size()) sum -= frame[next];
+            frame[next] = val;
+            next = (next + 1) % frame.size();
+        }
+        sum += val;
+        seen++;
+
+        if(average)
+        {
+            auto count = frame.size() && seen > frame.size() ? frame.size() : seen;
+            double av = ((double)sum) / count;
+            return *(cell*)&av;
+        }
+        return *(cell*)&sum;
+    }
+};
+
+// Max and min. Keeps a monotonic deque of candidate rows, ordered
+// so the front is the extreme of the frame. A new row drops all
+// candidates it beats from the back, as they leave the frame before
+// it does, and the front is dropped when it leaves the frame.
+// Each row is pushed and popped at most once, so O(1) amortized.
+template<typename T, typename Better>
+struct extreme_state : window_state
+{
+    std::deque<std::pair<unsigned long long int, T>> candidates;
+    unsigned int rows;
+    unsigned long long int seen;
+
+    extreme_state(unsigned int rows_) : rows(rows_), seen(0) {};
+
+    cell push(const cell& value) override
+    {
+        T val = *(const T*)&value;
+        while(!candidates.empty() && !Better()(candidates.back().second, val))
+            candidates.pop_back();
+        candidates.push_back(std::make_pair(seen, val));
+
+        if(rows)
+        {
+            if(candidates.front().first + rows <= seen)
+                candidates.pop_front();
+        }
+        else // Whole partition, only the extreme can matter
+        {
+            candidates.resize(1);
+        }
+        seen++;
+
+        return *(cell*)&candidates.front().second;
+    }
+};
+
+// Value offset rows before in the partition, held in a ring buffer.
+// Rows with nothing that far back get 0, as NULL is not supported.
+template<typename T>
+struct lag_state : window_state
+{
+    std::vector<T> previous;
+    unsigned int next;
+    unsigned long long int seen;
+
+    lag_state(unsigned int offset) : previous(offset), next(0), seen(0) {};
+
+    cell push(const cell& value) override
+    {
+        if(!previous.size())
+            return value;
+
+        T ret = seen >= previous.size() ? previous[next] : 0;
+        previous[next] = *(const T*)&value;
+        next = (next + 1) % previous.size();
+        seen++;
+        return *(cell*)&ret;
+    }
+};
+
+template<typename T>
+static std::unique_ptr<window_state> make_state_impl(std::string& name,
+                                                     unsigned int rows,
+                                                     unsigned int offset)
+{
+    if(name == "sum")
+        return std::unique_ptr<window_state>(new sum_state<T>(rows, false));
+    if(name == "average")
+        return std::unique_ptr<window_state>(new sum_state<T>(rows, true));
+    if(name == "max")
+        return std::unique_ptr<window_state>(
+                    new extreme_state<T, std::greater<T>>(rows));
+    if(name == "min")
+        return std::unique_ptr<window_state>(
+                    new extreme_state<T, std::less<T>>(rows));
+    if(name == "lag")
+        return std::unique_ptr<window_state>(new lag_state<T>(offset));
+
+    // lead is resolved by the window_view, as it needs rows after this one.
+    return nullptr;
+}
+
+// Unpacks an OVER node. The function is the first argument,
+// followed by the PARTITION_BY, ORDER_BY and ROWS clauses in any order.
+window_function_t::window_function_t(parse_tree_node& node, from_t& from)
+{
+    auto& function = node.args[0];
+    name = function.token.raw_rep;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    if(name != "sum" && name != "average" && name != "max" &&
+       name != "min" && name != "lag"     && name != "lead")
+    {
+        std::cerr << function.token.raw_rep << " not supported as a window function."
+                  << std::endl;
+        throw 0;
+    }
+
+    // Parser constructs the arguments in reverse order.
+    if(name == "lag" || name == "lead")
+    {
+        if(function.args.size() != 1 && function.args.size() != 2)
+        {
+            std::cerr << name << " takes an expression and an optional offset." << std::endl;
+            throw 0;
+        }
+        offset = 1;
+        if(function.args.size() == 2)
+        {
+            if(function.args[0].token.t != token_t::INT_LITERAL ||
+               function.args[0].token.value.i < 0)
+            {
+                std::cerr << "Offset to " << name
+                          << " must be a non-negative integer." << std::endl;
+                throw 0;
+            }
+            offset = function.args[0].token.value.i;
+        }
+    }
+    else if(function.args.size() != 1)
+    {
+        std::cerr << "Only univariate window functions supported." << std::endl;
+        throw 0;
+    }
+
+    input = expression_factory(function.args.back(), from);
+    return_type = name == "average" ? cell_type::FLOAT : input->return_type;
+
+    bool seen_rows = false;
+    for(unsigned int i = 1; i < node.args.size(); i++)
+    {
+        auto& arg = node.args[i];
+        switch(arg.token.t)
+        {
+            case token_t::PARTITION_BY:
+            {
+                if(partition)
+                {
+                    std::cerr << "Unexpected PARTITION_BY clause." << std::endl;
+                    throw 0;
+                }
+                partition = expression_factory(arg.args[0], from);
+                break;
+            }
+            case token_t::ORDER_BY:
+            {
+                if(order)
+                {
+                    std::cerr << "Unexpected ORDER_BY clause." << std::endl;
+                    throw 0;
+                }
+                order = expression_factory(arg.args[0], from);
+                break;
+            }
+            case token_t::ROWS:
+            {
+                if(seen_rows || name == "lag" || name == "lead")
+                {
+                    std::cerr << "Unexpected ROWS clause." << std::endl;
+                    throw 0;
+                }
+                if(arg.args[0].token.t != token_t::INT_LITERAL ||
+                   arg.args[0].token.value.i <= 0)
+                {
+                    std::cerr << "ROWS must be a positive integer." << std::endl;
+                    throw 0;
+                }
+                rows = arg.args[0].token.value.i;
+                seen_rows = true;
+                break;
+            }
+            default:
+            {
+                std::cerr << "Unexpected clause in OVER." << std::endl;
+                throw 0;
+            }
+        }
+    }
+}
+
+std::unique_ptr<window_state> window_function_t::make_state()
+{
+    if(input->return_type == cell_type::INT)
+        return make_state_impl<long long int>(name, rows, offset);
+    else
+        return make_state_impl<double>(name, rows, offset);
+}
+
+// The engine doesn't sort, so ORDER_BY checks the
+// input already comes in order within each partition.
+window_partition& window_function_t::current_partition()
+{
+    long long int key = partition ? partition->call().i : 0;
+    auto found = partitions.find(key);
+    if(found == partitions.end())
+    {
+        // Frames and lag's rows are held per partition, lead's rows in
+        // it's waiting queue.
+        limits.charge(sizeof(window_partition) + (rows + offset) * sizeof(cell));
+        found = partitions.emplace(std::make_pair(key, window_partition())).first;
+        found->second.state = make_state();
+    }
+
+    auto& current = found->second;
+    if(order)
+    {
+        cell value = order->call();
+        if(current.seen &&
+           (order->return_type == cell_type::INT ? value.i < current.last_order.i
+                                                 : value.d < current.last_order.d))
+        {
+            std::cerr << "Input to window function " << name
+                      << " is not ordered by it's ORDER_BY expression." << std::endl;
+            throw 0;
+        }
+        current.last_order = value;
+        current.seen = true;
+    }
+
+    return current;
+}
+
+// Leaf expression reading a window function's value for the current row.
+struct window_accessor : expression_t
+{
+    window_view* view;
+    unsigned int function;
+
+    window_accessor(window_view* view_,
+                    unsigned int function_) : view(view_), function(function_)
+    {
+        return_type = view->functions[function]->return_type;
+    }
+
+    cell call() override
+    {
+        return view->rows.front().windows[function];
+    }
+};
+
+// Compiles every distinct window function in the select,
+// then reads ahead to the first row we can output.
+window_view::window_view(from_t& from,
+                         parse_tree_node& where_node,
+                         std::vector<parse_tree_node>& window_nodes) :
+                                    table_view(), source(from.view), source_from(from),
+                                    where(where_node, source_from)
+{
+    name         = source->name;
+    column_names = source->column_names;
+    column_types = source->column_types;
+
+    for(auto& node : window_nodes)
+    {
+        auto key = expression_key(node, source_from);
+        if(std::find(keys.begin(), keys.end(), key) != keys.end())
+            continue;
+
+        functions.emplace_back(new window_function_t(node, source_from));
+        keys.push_back(key);
+    }
+
+    skip_filtered();
+    fill();
+}
+
+std::unique_ptr<expression_t> window_view::accessor(parse_tree_node& node, from_t& from)
+{
+    auto key = expression_key(node, from);
+    unsigned int function = std::find(keys.begin(), keys.end(), key) - keys.begin();
+    if(function == keys.size())
+    {
+        std::cerr << "INTERNAL: Unregistered window function." << std::endl;
+        throw 0;
+    }
+
+    return std::unique_ptr<expression_t>(new window_accessor(this, function));
+}
+
+void window_view::skip_filtered()
+{
+    while(!source->empty() && !where.filter())
+        source->advance_row();
+}
+
+// Copy the source's current row, and push it to each window function.
+// Rows wait in lead's partition until offset more rows of the
+// partition have been read, which then provides the value.
+void window_view::read_row()
+{
+    rows.push_back(std::move(spare));
+    auto& row = rows.back();
+
+    row.values.resize(source->width());
+    for(unsigned int i = 0; i < row.values.size(); i++)
+        row.values[i] = source->access_column(i);
+
+    row.windows.assign(functions.size(), cell());
+    row.pending = 0;
+    for(unsigned int f = 0; f < functions.size(); f++)
+    {
+        auto& function = *functions[f];
+        auto& partition = function.current_partition();
+        cell value = function.input->call();
+
+        if(partition.state)
+        {
+            row.windows[f] = partition.state->push(value);
+        }
+        else
+        {
+            partition.waiting.push_back(&row);
+            row.pending++;
+            if(partition.waiting.size() > function.offset)
+            {
+                auto waiting = partition.waiting.front();
+                partition.waiting.pop_front();
+                waiting->windows[f] = value;
+                waiting->pending--;
+            }
+        }
+    }
+
+    source->advance_row();
+    skip_filtered();
+}
+
+// Read until the first row has all it's values. Once the source
+// is exhausted, rows still waiting on lead keep their 0 values.
+void window_view::fill()
+{
+    while(!source->empty() && (rows.empty() || rows.front().pending))
+        read_row();
+}
+
+cell window_view::access_column(unsigned int i)
+{
+    return rows.front().values[i];
+}
+
+// Keep the row we're done with, so reading the next
+// one can reuse it's allocations.
+void window_view::advance_row()
+{
+    spare = std::move(rows.front());
+    rows.pop_front();
+    fill();
+}
+
+bool window_view::empty()
+{
+    return rows.empty();
+}
+
+unsigned int window_view::width()
+{
+    return source->width();
+}
+
+// Speculative
+unsigned int window_view::height()
+{
+    return source->height();
+}
+
+std::shared_ptr<table_iterator> window_view::load()
+{
+    return std::make_shared<table_iterator>(*this);
+}
+
+bool contains_window(parse_tree_node& node)
+{
+    if(node.token.t == token_t::OVER)
+        return true;
+
+    for(auto& arg : node.args)
+        if(contains_window(arg))
+            return true;
+
+    return false;
+}
+
+void collect_windows(parse_tree_node& node, std::vector<parse_tree_node>& window_nodes)
+{
+    if(node.token.t == token_t::OVER)
+    {
+        window_nodes.push_back(node);
+        return;
+    }
+
+    for(auto& arg : node.args)
+        collect_windows(arg, window_nodes);
+}
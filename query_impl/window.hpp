@@ -0,0 +1,126 @@
+#ifndef _WINDOW_H
+#define _WINDOW_H
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../parser.hpp"
+#include "../table.hpp"
+#include "../table_views.hpp"
+
+#include "expression.hpp"
+#include "from.hpp"
+#include "where.hpp"
+
+// Window functions, i.e.
+// average(PRICE) OVER (PARTITION_BY ID, ORDER_BY TIME, ROWS 10)
+
+// Computed in a single streaming pass over the filtered FROM view.
+// Each function keeps incremental state per partition, so every
+// row costs O(1) regardless of the frame size.
+
+// Incremental state of a window function within one partition.
+// push is called with the input value of each row in the partition
+// in order, and returns the function value for that row.
+struct window_state
+{
+    virtual cell push(const cell& value) = 0;
+    virtual ~window_state() = default;
+};
+
+struct window_row;
+
+struct window_partition
+{
+    std::unique_ptr<window_state> state;
+
+    // Last ORDER_BY value seen, to check the input is ordered.
+    cell last_order;
+    bool seen = false;
+
+    // lead only, rows still waiting for their value.
+    std::deque<window_row*> waiting;
+};
+
+struct window_function_t
+{
+    std::string name;
+    cell_type return_type;
+    std::unique_ptr<expression_t> input;
+    std::unique_ptr<expression_t> partition;
+    std::unique_ptr<expression_t> order;
+
+    // Frame is the current row and the rows - 1 before it.
+    // 0 for a frame from the start of the partition.
+    unsigned int rows = 0;
+
+    // Distance for lag and lead.
+    unsigned int offset = 0;
+
+    std::unordered_map<long long int, window_partition> partitions;
+
+    window_function_t(parse_tree_node& node, from_t& from);
+
+    // Partition the source's current row belongs to.
+    window_partition& current_partition();
+    std::unique_ptr<window_state> make_state();
+};
+
+// A row read from the source, with the values of
+// each window function. Rows with pending lead values
+// can't be output until we've read far enough ahead.
+struct window_row
+{
+    std::vector<cell> values;
+    std::vector<cell> windows;
+    unsigned int pending;
+};
+
+// View over the FROM of a select with window functions.
+// Takes over the WHERE clause, as windows are computed
+// on the filtered rows, but before OFFSET and LIMIT.
+
+// Exposes the same columns as the source. Rows are buffered,
+// which is only more than one row deep for lead.
+struct window_view : table_view
+{
+    std::shared_ptr<table_view> source;
+    from_t source_from;
+    where_t where;
+
+    std::vector<std::unique_ptr<window_function_t>> functions;
+    std::vector<std::string> keys;
+    std::deque<window_row> rows;
+
+    window_view(from_t& from,
+                parse_tree_node& where_node,
+                std::vector<parse_tree_node>& window_nodes);
+
+    // Returns an expression reading the value of the window
+    // function in node for the current row.
+    std::unique_ptr<expression_t> accessor(parse_tree_node& node, from_t& from);
+
+    cell access_column(unsigned int i) override;
+    void advance_row() override;
+    bool empty() override;
+    unsigned int width() override;
+    unsigned int height() override;
+    std::shared_ptr<table_iterator> load() override;
+
+    private:
+    window_row spare;
+
+    void skip_filtered();
+    void read_row();
+    void fill();
+};
+
+// Whether an expression contains a window function anywhere,
+// and collecting them.
+bool contains_window(parse_tree_node& node);
+void collect_windows(parse_tree_node& node, std::vector<parse_tree_node>& window_nodes);
+
+#endif
@@ -0,0 +1,84 @@
+#include <csignal>
+#include <signal.h>
+#include <iostream>
+
+#include "metrics.hpp"
+#include "query_limits.hpp"
+
+thread_local query_limits limits;
+
+// Timeouts past the end of the clock never expire.
+void query_limits::begin()
+{
+    flags->cancelled = false;
+    flags->failed    = false;
+    flags->bytes     = 0;
+    auto now     = std::chrono::steady_clock::now();
+    auto timeout = std::chrono::duration<double, std::milli>(statement_timeout);
+    if(timeout < std::chrono::steady_clock::time_point::max() - now)
+        deadline = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+    else
+        deadline = std::chrono::steady_clock::time_point::max();
+}
+
+void query_limits::check()
+{
+    if(flags->cancelled)
+    {
+        if(!flags->failed.exchange(true))
+            std::cerr << "Statement cancelled." << std::endl;
+        throw 0;
+    }
+
+    if(statement_timeout > 0 && std::chrono::steady_clock::now() > deadline)
+    {
+        if(!flags->failed.exchange(true))
+            std::cerr << "Statement exceeded statement_timeout of "
+                      << statement_timeout << "ms." << std::endl;
+        throw 0;
+    }
+}
+
+void query_limits::charge(unsigned long long int bytes)
+{
+    auto total = flags->bytes += bytes;
+    metrics.add_query_bytes(total);
+    if(memory_limit && total > memory_limit)
+    {
+        if(!flags->failed.exchange(true))
+            std::cerr << "Statement exceeded memory_limit of "
+                      << memory_limit << " bytes." << std::endl;
+        throw 0;
+    }
+}
+
+// Cancelled flag of the shell's statements, published before the
+// handler is installed. The handler only stores to it.
+static std::atomic<bool>* interrupt_flag = nullptr;
+
+static void interrupted(int)
+{
+    interrupt_flag->store(true);
+}
+
+// Without SA_RESTART, Ctrl-C fails the read of the prompt with
+// EINTR, rather than the read carrying on where it was.
+static void install_handler(bool restart)
+{
+    struct sigaction action;
+    action.sa_handler = interrupted;
+    action.sa_flags   = restart ? SA_RESTART : 0;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+}
+
+void watch_interrupts()
+{
+    interrupt_flag = &limits.flags->cancelled;
+    install_handler(true);
+}
+
+void interrupt_reads(bool interrupting)
+{
+    install_handler(!interrupting);
+}
@@ -0,0 +1,68 @@
+#ifndef _QUERY_LIMITS_H
+#define _QUERY_LIMITS_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+// Limits on the statements of a session, changed with SET, i.e.
+// SET statement_timeout = 5000
+// SET memory_limit = 1000000000
+// in ms and bytes, 0 for none. A statement going over either, or
+// cancelled with Ctrl-C in the shell, fails with an error and
+// leaves the loaded tables as they were.
+
+// The deadline is checked every check_rows rows a scan advances,
+// which every operator pulls it's rows through. Memory is charged
+// to the statement as columns, indexes, aggregate and window state
+// and output buffers are allocated, by whichever thread allocates
+// them, and counted in the query memory of the metrics.
+struct query_limits
+{
+    static const unsigned int check_rows = 1 << 12;
+
+    double                 statement_timeout = 0;
+    unsigned long long int memory_limit      = 0;
+
+    // Of the statement running, shared with the copies the
+    // scheduler runs its tasks under, see scheduler.hpp.
+    struct statement_flags
+    {
+        std::atomic<bool> cancelled{false};
+
+        // Set by the first check to fail, which reports it, as
+        // tasks of the statement may fail at the same time.
+        std::atomic<bool> failed{false};
+
+        // Bytes charged to the statement so far.
+        std::atomic<unsigned long long int> bytes{0};
+    };
+    std::shared_ptr<statement_flags> flags = std::make_shared<statement_flags>();
+
+    // Called as a statement starts, on the thread running it.
+    void begin();
+
+    // Throws if the statement was cancelled or is past it's deadline.
+    void check();
+
+    // Charges bytes the statement allocated, throwing if
+    // that takes it over memory_limit.
+    void charge(unsigned long long int bytes);
+
+    private:
+    std::chrono::steady_clock::time_point deadline;
+};
+
+// Per thread, as each connection of a server has it's own.
+extern thread_local query_limits limits;
+
+// Installs a Ctrl-C handler for the rest of the session, which
+// cancels the statement the calling thread is running, rather than
+// exiting. The calling thread's flags must outlive the session.
+void watch_interrupts();
+
+// While interrupting, Ctrl-C also fails a read in progress, so the
+// shell can drop the line being typed at the prompt.
+void interrupt_reads(bool interrupting);
+
+#endif
@@ -0,0 +1,194 @@
+#include <cmath>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+#include "result_writer.hpp"
+#include "server.hpp"
+
+result_writer::result_writer(int fd_) : fd(fd_), buffer(buffer_size)
+{
+    if(connection.fd >= 0)
+    {
+        fd     = connection.fd;
+        framed = true;
+    }
+    std::cout.flush();
+}
+
+result_writer::~result_writer()
+{
+    flush();
+}
+
+void result_writer::write_through(const char* data, unsigned int length)
+{
+    if(framed)
+    {
+        // A client that's gone just stops getting results.
+        if(length && !connection.lost && !write_frame(fd, DATA, data, length))
+            connection.lost = true;
+        return;
+    }
+
+    while(length)
+    {
+        auto written = ::write(fd, data, length);
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            std::cerr << "Error writing results." << std::endl;
+            return;
+        }
+        data   += written;
+        length -= written;
+    }
+}
+
+void result_writer::flush()
+{
+    write_through(buffer.data(), used);
+    used = 0;
+}
+
+void result_writer::write_cell(const cell& value, cell_type type)
+{
+    if(used + max_cell > buffer_size)
+        flush();
+
+    char* start = &buffer[used];
+    char* end   = type == cell_type::INT ? format_integer(value.i, start)
+                                         : format_double(value.d, start);
+    used += end - start;
+}
+
+void result_writer::write_cell(const cell& value, cell_type type, unsigned int width)
+{
+    char text[max_cell];
+    char* end = type == cell_type::INT ? format_integer(value.i, text)
+                                       : format_double(value.d, text);
+    for(unsigned int length = end - text; length < width; length++)
+        put(' ');
+    write(text, end - text);
+}
+
+void result_writer::write(const std::string& text, unsigned int width)
+{
+    for(unsigned int length = text.size(); length < width; length++)
+        put(' ');
+    write(text);
+}
+
+static const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Digits of value, written backwards from end.
+static char* format_digits(unsigned long long int value, char* end)
+{
+    while(value >= 100)
+    {
+        auto pair = (value % 100) * 2;
+        value /= 100;
+        *--end = digit_pairs[pair + 1];
+        *--end = digit_pairs[pair];
+    }
+    if(value >= 10)
+    {
+        *--end = digit_pairs[value * 2 + 1];
+        *--end = digit_pairs[value * 2];
+    }
+    else
+        *--end = '0' + value;
+    return end;
+}
+
+char* format_integer(long long int value, char* out)
+{
+    char digits[20];
+    char* end = digits + sizeof(digits);
+
+    unsigned long long int magnitude = value;
+    if(value < 0)
+    {
+        *out++ = '-';
+        magnitude = 0 - magnitude;
+    }
+
+    char* start = format_digits(magnitude, end);
+    memcpy(out, start, end - start);
+    return out + (end - start);
+}
+
+static const double powers_of_ten[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+
+// Most values are short decimals. For those, the fewest fractional
+// digits k for which some integer m has m / 10^k == value gives the
+// shortest digits. As m and 10^k are exact doubles, the division is
+// correctly rounded, i.e. m / 10^k is what reading it back would give.
+// Otherwise use the fewest significant digits that read back, up to 17,
+// which always do. Values that need more than 15 digits nearly always
+// need 16 or 17, so 15 digits decides which end to search from.
+char* format_double(double value, char* out)
+{
+    double magnitude = std::fabs(value);
+    if(magnitude < 1e15)
+    {
+        for(unsigned int k = 0; k < sizeof(powers_of_ten) / sizeof(double); k++)
+        {
+            double scaled = magnitude * powers_of_ten[k];
+            if(scaled >= 9007199254740992.0)
+                break;
+
+            auto m = (unsigned long long int)(scaled + 0.5);
+            if(m / powers_of_ten[k] != magnitude)
+                continue;
+
+            if(std::signbit(value))
+                *out++ = '-';
+
+            char digits[24];
+            char* end   = digits + sizeof(digits);
+            char* start = format_digits(m, end);
+
+            // Pad with zeros to have a digit before the point.
+            while(end - start <= (long)k)
+                *--start = '0';
+
+            auto integer_digits = (end - start) - k;
+            memcpy(out, start, integer_digits);
+            out += integer_digits;
+            if(k)
+            {
+                *out++ = '.';
+                memcpy(out, start + integer_digits, k);
+                out += k;
+            }
+            return out;
+        }
+    }
+
+    int first = 16, last = 17;
+    snprintf(out, result_writer::max_cell, "%.15g", value);
+    if(strtod(out, nullptr) == value)
+    {
+        first = 1;
+        last  = 15;
+    }
+
+    for(int precision = first; precision <= last; precision++)
+    {
+        int length = snprintf(out, result_writer::max_cell, "%.*g", precision, value);
+        if(precision == last || strtod(out, nullptr) == value)
+            return out + length;
+    }
+    return out;
+}
@@ -0,0 +1,76 @@
+#ifndef _RESULT_WRITER_H
+#define _RESULT_WRITER_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "table.hpp"
+
+// Buffered writer for query results. Rows are formatted into a
+// reusable buffer that's written with one write(2) when full, rather
+// than going through std::cout cell by cell and flushing every row.
+
+// Integers and doubles are formatted by hand. Doubles are written with
+// the fewest digits that read back as the same double.
+struct result_writer
+{
+    static const unsigned int buffer_size = 1 << 16;
+
+    // Longest a formatted cell can be.
+    static const unsigned int max_cell = 32;
+
+    int               fd;
+    bool              framed = false;
+    std::vector<char> buffer;
+    unsigned int      used = 0;
+
+    // Flushes std::cout first, so anything already printed comes before us.
+    // On a thread serving a connection, writes DATA frames to it instead.
+    result_writer(int fd_ = 1);
+    ~result_writer();
+
+    void flush();
+
+    void write(const char* data, unsigned int length)
+    {
+        if(used + length > buffer_size)
+        {
+            flush();
+            if(length > buffer_size)
+            {
+                write_through(data, length);
+                return;
+            }
+        }
+        memcpy(&buffer[used], data, length);
+        used += length;
+    }
+
+    void write(const std::string& text)
+    {
+        write(text.c_str(), text.size());
+    }
+
+    void put(char c)
+    {
+        if(used == buffer_size)
+            flush();
+        buffer[used++] = c;
+    }
+
+    void write_cell(const cell& value, cell_type type);
+
+    // Right aligned in width characters, like std::setw.
+    void write_cell(const cell& value, cell_type type, unsigned int width);
+    void write(const std::string& text, unsigned int width);
+
+    private:
+    void write_through(const char* data, unsigned int length);
+};
+
+// Write the value at out, returning the end of what was written.
+char* format_integer(long long int value, char* out);
+char* format_double(double value, char* out);
+
+#endif
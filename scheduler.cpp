@@ -0,0 +1,160 @@
+#include <algorithm>
+
+#include "scheduler.hpp"
+
+scheduler_t scheduler;
+
+// Index of the worker we're running on, of the shared queue if we're not one.
+static thread_local int worker_index = -1;
+
+void scheduler_t::start(unsigned int threads)
+{
+    unsigned int count = threads ? threads - 1 : 0;
+    for(unsigned int i = 0; i <= count; i++)
+        queues.emplace_back(new task_queue());
+    for(unsigned int i = 0; i < count; i++)
+        workers.emplace_back(&scheduler_t::work, this, i);
+}
+
+unsigned int scheduler_t::threads()
+{
+    return workers.size() + 1;
+}
+
+scheduler_t::~scheduler_t()
+{
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        stopping = true;
+    }
+    idle.notify_all();
+    for(auto& worker : workers)
+        worker.join();
+}
+
+void scheduler_t::submit(task_group& group, std::function<void()> run)
+{
+    group.pending++;
+    unsigned int home = worker_index >= 0 ? worker_index : workers.size();
+    {
+        std::lock_guard<std::mutex> guard(queues[home]->lock);
+        queues[home]->tasks.push_back(task{ &group, std::move(run), limits });
+    }
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        queued++;
+    }
+    idle.notify_one();
+}
+
+// Runs the newest task of our own queue, or the oldest of
+// another. Returns false if there weren't any.
+bool scheduler_t::run_one(unsigned int home)
+{
+    task next;
+    bool found = false;
+    for(unsigned int i = 0; i < queues.size() && !found; i++)
+    {
+        auto& queue = *queues[(home + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if(queue.tasks.empty())
+            continue;
+
+        if(i == 0)
+        {
+            next = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            next = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        found = true;
+    }
+    if(!found)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        queued--;
+    }
+
+    auto own_limits = limits;
+    limits = next.limits;
+    try
+    {
+        next.run();
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        if(!next.group->error)
+            next.group->error = std::current_exception();
+    }
+    limits = own_limits;
+    // The group may be gone once it's waiter sees it's done.
+    if(--next.group->pending == 0)
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        idle.notify_all();
+    }
+    return true;
+}
+
+void scheduler_t::work(unsigned int index)
+{
+    worker_index = index;
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> guard(idle_lock);
+            idle.wait(guard, [&]{ return queued || stopping; });
+            if(stopping)
+                return;
+        }
+        run_one(index);
+    }
+}
+
+void scheduler_t::wait(task_group& group)
+{
+    unsigned int home = worker_index >= 0 ? worker_index : workers.size();
+    while(group.pending)
+    {
+        if(run_one(home))
+            continue;
+
+        // The last tasks are running elsewhere, sleep until
+        // they're done or there's another task to help with.
+        std::unique_lock<std::mutex> guard(idle_lock);
+        idle.wait(guard, [&]{ return !group.pending || queued; });
+    }
+
+    if(group.error)
+    {
+        auto error = group.error;
+        group.error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void parallel_for(size_t count, size_t morsel_size,
+                  const std::function<void(size_t, size_t)>& body)
+{
+    // Nothing to share, the morsels run here in order.
+    if(count <= morsel_size || scheduler.threads() == 1)
+    {
+        for(size_t begin = 0; begin < count; begin += morsel_size)
+            body(begin, std::min(count, begin + morsel_size));
+        return;
+    }
+
+    task_group group;
+    for(size_t begin = 0; begin < count; begin += morsel_size)
+    {
+        size_t end = std::min(count, begin + morsel_size);
+        scheduler.submit(group, [&body, begin, end]{ body(begin, end); });
+    }
+    scheduler.wait(group);
+}
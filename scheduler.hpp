@@ -0,0 +1,83 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "query_limits.hpp"
+
+// Pool of worker threads shared by everything that runs in parallel.
+// Work is handed to it in morsels, a range of rows or columns at a time,
+// so loads, analysis and output of queries running at the same time all
+// share the one set of threads. Sized by --threads, a thread per core by
+// default, counting the threads that wait for work to finish.
+
+// Each worker has a deque of tasks, runs the newest of it's own first
+// and steals the oldest of another's when it has none. Threads waiting
+// on a task_group run tasks while they wait, so tasks can submit and
+// wait for tasks of their own, and sleep when there are none to run.
+
+// Tasks submitted together, to be waited for. The first
+// exception a task throws is rethrown by wait().
+struct task_group
+{
+    std::atomic<unsigned int> pending{0};
+    std::exception_ptr        error;
+};
+
+struct scheduler_t
+{
+    // Starts threads - 1 workers, none to run everything on the waiting thread.
+    void start(unsigned int threads);
+    unsigned int threads();
+
+    void submit(task_group& group, std::function<void()> task);
+
+    // Runs tasks until all of the group's are done.
+    void wait(task_group& group);
+
+    ~scheduler_t();
+
+    private:
+    // Tasks run under the limits of the statement submitting them.
+    struct task
+    {
+        task_group*           group;
+        std::function<void()> run;
+        query_limits          limits;
+    };
+
+    // One per worker, and a last one for tasks from other threads.
+    struct task_queue
+    {
+        std::mutex       lock;
+        std::deque<task> tasks;
+    };
+
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread>                 workers;
+
+    std::mutex              idle_lock;
+    std::condition_variable idle;
+    unsigned int            queued   = 0;
+    bool                    stopping = false;
+
+    bool run_one(unsigned int home);
+    void work(unsigned int index);
+};
+
+extern scheduler_t scheduler;
+
+// Calls body(begin, end) for each morsel of [0, count) of up to
+// morsel_size, in parallel, returning once they're all done.
+void parallel_for(size_t count, size_t morsel_size,
+                  const std::function<void(size_t, size_t)>& body);
+
+#endif
@@ -0,0 +1,339 @@
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <signal.h>
+#include <streambuf>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#include "output_format.hpp"
+#include "server.hpp"
+
+thread_local connection_t connection;
+
+static bool write_all(int fd, const char* data, size_t length)
+{
+    while(length)
+    {
+        auto written = ::write(fd, data, length);
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+        data   += written;
+        length -= written;
+    }
+    return true;
+}
+
+static bool read_all(int fd, char* data, size_t length)
+{
+    while(length)
+    {
+        auto got = ::read(fd, data, length);
+        if(got < 0 && errno == EINTR)
+            continue;
+        if(got <= 0)
+            return false;
+        data   += got;
+        length -= got;
+    }
+    return true;
+}
+
+bool write_frame(int fd, char type, const char* data, size_t length)
+{
+    char header[5];
+    uint32_t payload_length = length;
+    memcpy(header, &payload_length, 4);
+    header[4] = type;
+    return write_all(fd, header, sizeof(header)) && write_all(fd, data, length);
+}
+
+static bool read_frame_header(int fd, char& type, uint32_t& payload_length)
+{
+    char header[5];
+    if(!read_all(fd, header, sizeof(header)))
+        return false;
+
+    memcpy(&payload_length, header, 4);
+    type = header[4];
+    return true;
+}
+
+bool read_frame(int fd, char& type, std::string& payload)
+{
+    uint32_t payload_length;
+    if(!read_frame_header(fd, type, payload_length))
+        return false;
+
+    payload.resize(payload_length);
+    return read_all(fd, &payload[0], payload_length);
+}
+
+static bool unix_address(const std::string& path, sockaddr_un& address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return false;
+    }
+    strcpy(address.sun_path, path.c_str());
+    return true;
+}
+
+// Replaces the buffers of std::cout and std::cerr while serving.
+// What a connection's thread writes is held until flushed, then sent
+// to it as a frame of our type. Other threads write to the original.
+// std::cerr flushes after every <<, so messages are only sent a whole
+// line at a time, and the rest at the end of the query.
+// The streams are shared by every connection, so a failed write never
+// fails them, and they're never cleared, which would race with other
+// connections writing. A connection's failure is kept in it's
+// connection_t instead: it's marked lost and the rest of it's output is
+// dropped. Failed writes of other threads to the original are ignored.
+struct connection_buf : std::streambuf
+{
+    std::streambuf* original;
+    char            type;
+
+    connection_buf(std::streambuf* original_, char type_) : original(original_), type(type_) {};
+
+    // Per thread, as the streams are shared by every connection.
+    std::string& pending()
+    {
+        static thread_local std::string data, message;
+        return type == DATA ? data : message;
+    }
+
+    int overflow(int c) override
+    {
+        if(c == EOF)
+            return traits_type::not_eof(c);
+        if(connection.fd < 0)
+            original->sputc(c);
+        else if(!connection.lost)
+            pending().push_back(c);
+        return c;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override
+    {
+        if(connection.fd < 0)
+            original->sputn(s, n);
+        else if(!connection.lost)
+            pending().append(s, n);
+        return n;
+    }
+
+    int sync() override
+    {
+        if(connection.fd < 0)
+        {
+            original->pubsync();
+            return 0;
+        }
+        if(type != MESSAGE)
+            return send(pending().size());
+
+        // Up to the last newline, if any.
+        return send(pending().rfind('\n') + 1);
+    }
+
+    // Sends the first length bytes pending.
+    int send(size_t length)
+    {
+        auto& text = pending();
+        if(length && !connection.lost && !write_frame(connection.fd, type, text.data(), length))
+            connection.lost = true;
+        text.erase(0, length);
+        return 0;
+    }
+};
+
+static connection_buf* messages;
+
+// Connections being served, at most max_connections.
+static std::mutex              connections_lock;
+static std::condition_variable connection_closed;
+static unsigned int            connections = 0;
+
+static void serve_connection(int fd, std::function<void(std::string&)> run_query)
+{
+    connection.fd = fd;
+
+    char type;
+    uint32_t payload_length;
+    std::string payload;
+    while(read_frame_header(fd, type, payload_length))
+    {
+        if(type != QUERY || !payload_length)
+        {
+            std::cerr << "Expected a query." << std::endl;
+            break;
+        }
+
+        // Before allocating it, as any client can send a length.
+        if(payload_length > max_query_length)
+        {
+            std::cerr << "Query of " << payload_length << " bytes is over the limit of "
+                      << max_query_length << " bytes." << std::endl;
+            break;
+        }
+
+        payload.resize(payload_length);
+        if(!read_all(fd, &payload[0], payload_length))
+            break;
+
+        auto format = (format_t)payload[0];
+        if(format == format_t::CSV || format == format_t::ARROW || format == format_t::RAW)
+        {
+            out_format = format;
+            std::string query = payload.substr(1);
+            run_query(query);
+        }
+        else
+            std::cerr << "Unsupported output format " << (int)payload[0] << "." << std::endl;
+
+        std::cout.flush();
+        messages->send(messages->pending().size());
+        if(connection.lost || !write_frame(fd, connection.closing ? BYE : DONE, nullptr, 0) ||
+           connection.closing)
+            break;
+    }
+
+    close(fd);
+
+    std::lock_guard<std::mutex> guard(connections_lock);
+    connections--;
+    connection_closed.notify_one();
+}
+
+void run_server(const std::string& path,
+                std::function<void(std::string&)> run_query)
+{
+    sockaddr_un address;
+    if(!unix_address(path, address))
+        exit(1);
+
+    // Left by a server that's gone.
+    unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || bind(fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0)
+    {
+        std::cerr << "Could not listen on " << path << ": " << strerror(errno) << std::endl;
+        exit(1);
+    }
+
+    // Clients going away mid result shouldn't take us with them.
+    signal(SIGPIPE, SIG_IGN);
+
+    static connection_buf data(std::cout.rdbuf(), DATA), message(std::cerr.rdbuf(), MESSAGE);
+    std::cout.rdbuf(&data);
+    std::cerr.rdbuf(&message);
+    messages = &message;
+
+    std::cerr << "Serving on " << path << "." << std::endl;
+    while(true)
+    {
+        // Clients past the limit wait in the listen backlog.
+        {
+            std::unique_lock<std::mutex> guard(connections_lock);
+            connection_closed.wait(guard, []{ return connections < max_connections; });
+        }
+
+        int client = accept(fd, nullptr, nullptr);
+        if(client < 0)
+        {
+            if(errno != EINTR)
+                std::cerr << "Could not accept a connection: " << strerror(errno) << std::endl;
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> guard(connections_lock);
+            connections++;
+        }
+        std::thread(serve_connection, client, run_query).detach();
+    }
+}
+
+// Returns DONE, or BYE if the server closed the connection.
+static char send_query(int fd, const std::string& query)
+{
+    std::string payload(1, (char)out_format);
+    payload += query;
+    if(!write_frame(fd, QUERY, payload.data(), payload.size()))
+        return BYE;
+
+    char type;
+    while(read_frame(fd, type, payload))
+    {
+        switch(type)
+        {
+            case DATA:
+                write_all(1, payload.data(), payload.size());
+                break;
+            case MESSAGE:
+                std::cerr << payload << std::flush;
+                break;
+            case DONE:
+            case BYE:
+                return type;
+        }
+    }
+
+    std::cerr << "Lost connection to the server." << std::endl;
+    return BYE;
+}
+
+int run_client(const std::string& path, const std::string& query)
+{
+    sockaddr_un address;
+    if(!unix_address(path, address))
+        return 1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) < 0)
+    {
+        std::cerr << "Could not connect to " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    if(query.size())
+    {
+        send_query(fd, query);
+        close(fd);
+        return 0;
+    }
+
+    // Like the shell, statements can span lines, so
+    // they're only sent once there's a ;
+    std::string statement, line;
+    while(true)
+    {
+        std::cout << "> " << std::flush;
+        if(!std::getline(std::cin, line))
+            break;
+
+        statement += line + "\n";
+        auto end = statement.rfind(';');
+        if(end == std::string::npos)
+            continue;
+        if(send_query(fd, statement.substr(0, end + 1)) == BYE)
+            break;
+        statement.erase(0, end + 1);
+    }
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Server mode. --serve PATH keeps the tables loaded and runs queries
+// sent to a Unix domain socket at PATH, with a thread per connection,
+// serving up to max_connections at once. Others wait to be accepted.
+// --connect PATH runs queries through it instead of loading tables.
+
+// Frames are a u32 payload length, a type, then the payload.
+// Clients send QUERY frames, an output format (format_t) then
+// the query text, which is run like a line of the shell. Statements
+// not ended by a ; are dropped. The server replies with DATA frames
+// of what would've gone to stdout, MESSAGE frames of what would've
+// gone to stderr, then DONE, or BYE after EXIT, closing the connection.
+// Queries of over max_query_length bytes get a MESSAGE, then the
+// connection is closed.
+enum frame_type : char
+{
+    QUERY   = 'Q',
+    DATA    = 'D',
+    MESSAGE = 'E',
+    DONE    = 'Z',
+    BYE     = 'X',
+};
+
+static const uint32_t     max_query_length = 1 << 24;
+static const unsigned int max_connections  = 64;
+
+bool write_frame(int fd, char type, const char* data, size_t length);
+bool read_frame(int fd, char& type, std::string& payload);
+
+// The connection the current thread is serving, if fd isn't -1.
+// Results and std::cout and std::cerr go to it instead.
+struct connection_t
+{
+    int  fd      = -1;
+    bool closing = false;  // Set by EXIT
+    bool lost    = false;  // Set once a write to it fails
+};
+
+extern thread_local connection_t connection;
+
+// Serves until killed, calling run_query for each query
+// on the thread of it's connection.
+void run_server(const std::string& path,
+                std::function<void(std::string&)> run_query);
+
+// Sends query, or each statement read from stdin if it's empty,
+// writing the replies to stdout and stderr. Returns the exit status.
+int run_client(const std::string& path, const std::string& query);
+
+#endif
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shared_tables.hpp"
+#include "trace.hpp"
+
+bool shared_tables = false;
+
+static const char shared_magic[8] = { 'C', 'S', 'Q', 'L', 'S', 'H', 'M', '1' };
+
+// Start of a segment. The magic is written last, so a segment
+// without it is still being written by pid, or was abandoned.
+struct shared_header
+{
+    char                   magic[8];
+    unsigned long long int size;
+    long long int          pid;
+
+    unsigned long long int source_size;
+    long long int          source_mtime;
+
+    unsigned int width, height;
+    unsigned int zone_blocks;
+    unsigned int path_length;
+    unsigned int names_length;
+};
+
+static size_t align8(size_t offset)
+{
+    return (offset + 7) & ~(size_t)7;
+}
+
+// Offsets of each part of a segment, after the header:
+// the path, column names separated by NULs, types, sorted flags,
+// the columns one after another, then their zone maps.
+struct shared_layout
+{
+    size_t path, names, types, sorted, cells, zones, size;
+
+    shared_layout(unsigned int width, unsigned int height, unsigned int zone_blocks,
+                  unsigned int path_length, unsigned int names_length)
+    {
+        path   = sizeof(shared_header);
+        names  = path + path_length;
+        types  = align8(names + names_length);
+        sorted = align8(types + width * sizeof(unsigned int));
+        cells  = align8(sorted + width);
+        zones  = cells + (size_t)width * height * sizeof(cell);
+        size   = zones + (size_t)width * zone_blocks * sizeof(zone_t);
+    }
+};
+
+// Whether the header describes parts that exactly fill a segment of
+// size bytes, with width column names, so reading them by the
+// header stays inside the mapping.
+static bool valid_layout(const shared_header& header, const char* base, size_t size)
+{
+    if(header.path_length > size || header.names_length > size ||
+       header.width > size || header.height > size / sizeof(cell) ||
+       (header.width && header.height > size / sizeof(cell) / header.width) ||
+       header.zone_blocks != ((unsigned long long int)header.height + table::zone_rows - 1)
+                              / table::zone_rows)
+        return false;
+
+    shared_layout layout(header.width, header.height, header.zone_blocks,
+                         header.path_length, header.names_length);
+    if(layout.size != size)
+        return false;
+
+    const char* names = base + layout.names;
+    return (size_t)std::count(names, names + header.names_length, '\0') == header.width &&
+           (!header.names_length || !names[header.names_length - 1]);
+}
+
+// FNV-1a, with our uid, so users don't share segments.
+static std::string segment_name(const std::string& path)
+{
+    unsigned long long int hash = 14695981039346656037ULL;
+    for(unsigned char c : path)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+
+    char name[48];
+    snprintf(name, sizeof(name), "/csvsql.%u.%016llx", (unsigned int)geteuid(), hash);
+    return name;
+}
+
+// The copy in the segment, or nullptr if it's not there, isn't
+// finished, or is of a different version of the csv. It's columns
+// point into the mapping, which is unmapped along with the last of them.
+// Segments another user could have written are never trusted.
+static std::shared_ptr<table> attach(const std::string& name, const std::string& path,
+                                     struct stat& source, bool& stale)
+{
+    stale = false;
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd < 0)
+        return nullptr;
+
+    struct stat segment;
+    void* mapped = MAP_FAILED;
+    if(fstat(fd, &segment) == 0 && segment.st_uid == geteuid() &&
+       !(segment.st_mode & (S_IWGRP | S_IWOTH)) &&
+       (size_t)segment.st_size >= sizeof(shared_header))
+        mapped = mmap(nullptr, segment.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return nullptr;
+
+    auto  base   = (const char*)mapped;
+    auto& header = *(const shared_header*)mapped;
+    std::shared_ptr<table> attached;
+
+    if(memcmp(header.magic, shared_magic, sizeof(shared_magic)))
+    {
+        // Left by a process that died writing it.
+        stale = kill(header.pid, 0) < 0 && errno == ESRCH;
+    }
+    else if(header.size != (unsigned long long int)segment.st_size ||
+            !valid_layout(header, base, segment.st_size) ||
+            header.source_size  != (unsigned long long int)source.st_size ||
+            header.source_mtime != source.st_mtim.tv_sec * 1000000000LL + source.st_mtim.tv_nsec ||
+            std::string(base + sizeof(shared_header), header.path_length) != path)
+    {
+        stale = true;
+    }
+    else
+    {
+        shared_layout layout(header.width, header.height, header.zone_blocks,
+                             header.path_length, header.names_length);
+        size_t size = segment.st_size;
+        std::shared_ptr<const void> mapping(mapped, [size](const void* mapped)
+                                            {
+                                                munmap((void*)mapped, size);
+                                            });
+        attached = std::make_shared<table>();
+        attached->width  = header.width;
+        attached->height = header.height;
+
+        const char* names = base + layout.names;
+        auto types  = (const unsigned int*)(base + layout.types);
+        auto cells  = (const cell*)(base + layout.cells);
+        auto zones  = (const zone_t*)(base + layout.zones);
+        for(unsigned int i = 0; i < header.width; i++)
+        {
+            attached->column_names.push_back(names);
+            names += attached->column_names.back().size() + 1;
+            attached->column_types.push_back((cell_type)types[i]);
+            attached->sorted.push_back(base[layout.sorted + i]);
+
+            attached->cells.emplace_back(mapping, cells + (size_t)i * header.height,
+                                         header.height);
+            attached->zones.emplace_back(zones + (size_t)i * header.zone_blocks,
+                                         zones + (size_t)(i + 1) * header.zone_blocks);
+        }
+    }
+
+    if(!attached)
+        munmap(mapped, segment.st_size);
+    return attached;
+}
+
+// Leaves a copy of loaded in a new segment. Gives up quietly
+// if another process got there first.
+static void publish(const std::string& name, const std::string& path,
+                    struct stat& source, table& loaded)
+{
+    std::string names;
+    for(auto& column_name : loaded.column_names)
+    {
+        names += column_name;
+        names += '\0';
+    }
+
+    unsigned int zone_blocks = loaded.zones.size() ? loaded.zones[0].size() : 0;
+    shared_layout layout(loaded.width, loaded.height, zone_blocks, path.size(), names.size());
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0)
+        return;
+
+    void* mapped = MAP_FAILED;
+    if(ftruncate(fd, layout.size) == 0)
+        mapped = mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+    {
+        std::cerr << "Could not create shared memory for " << path
+                  << ": " << strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return;
+    }
+
+    auto  base   = (char*)mapped;
+    auto& header = *(shared_header*)mapped;
+    header.size         = layout.size;
+    header.pid          = getpid();
+    header.source_size  = source.st_size;
+    header.source_mtime = source.st_mtim.tv_sec * 1000000000LL + source.st_mtim.tv_nsec;
+    header.width        = loaded.width;
+    header.height       = loaded.height;
+    header.zone_blocks  = zone_blocks;
+    header.path_length  = path.size();
+    header.names_length = names.size();
+
+    memcpy(base + layout.path, path.data(), path.size());
+    memcpy(base + layout.names, names.data(), names.size());
+    for(unsigned int i = 0; i < loaded.width; i++)
+    {
+        ((unsigned int*)(base + layout.types))[i] = loaded.column_types[i];
+        base[layout.sorted + i] = loaded.sorted[i];
+        memcpy(base + layout.cells + (size_t)i * loaded.height * sizeof(cell),
+               loaded.cells[i].data(), (size_t)loaded.height * sizeof(cell));
+        memcpy(base + layout.zones + (size_t)i * zone_blocks * sizeof(zone_t),
+               loaded.zones[i].data(), (size_t)zone_blocks * sizeof(zone_t));
+    }
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header.magic, shared_magic, sizeof(shared_magic));
+    munmap(mapped, layout.size);
+}
+
+std::shared_ptr<table> load_table(std::string& file_name)
+{
+    char path[PATH_MAX];
+    struct stat source;
+    if(!shared_tables || !realpath(file_name.c_str(), path) || stat(path, &source) < 0)
+        return std::make_shared<table>(file_name);
+
+    auto name = segment_name(path);
+    bool stale;
+    std::shared_ptr<table> loaded;
+    {
+        trace_span span("attach shared table");
+        loaded = attach(name, path, source, stale);
+    }
+    if(loaded)
+    {
+        if(analyze_on_load)
+            loaded->analyze();
+        return loaded;
+    }
+
+    // Processes still reading the old segment keep it until they're done.
+    if(stale)
+        shm_unlink(name.c_str());
+
+    loaded = std::make_shared<table>(file_name);
+    trace_span span("publish shared table");
+    publish(name, path, source, *loaded);
+    return loaded;
+}
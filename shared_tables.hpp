@@ -0,0 +1,25 @@
+#ifndef _SHARED_TABLES_H
+#define _SHARED_TABLES_H
+
+#include <memory>
+#include <string>
+
+#include "table.hpp"
+
+// Tables kept in POSIX shared memory between runs, with --shm.
+
+// Each csv loaded gets a segment named /csvsql.<uid>.<hash of it's path>
+// in /dev/shm, readable only by us, holding the columns, zone maps and sorted flags, with
+// a catalog header of the column names and types and the csv's size
+// and modification time. Later runs loading the same csv read the
+// columns straight from the segment instead of parsing it, as long
+// as the csv hasn't changed since. Segments outlive the process, clear them with
+// rm /dev/shm/csvsql.*
+
+// Set by --shm.
+extern bool shared_tables;
+
+// Loads the csv, through shared memory when shared_tables is set.
+std::shared_ptr<table> load_table(std::string& file_name);
+
+#endif
@@ -0,0 +1,99 @@
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "metrics.hpp"
+#include "slow_log.hpp"
+
+#include "query_impl/cost.hpp"
+#include "query_impl/explain.hpp"
+
+slow_query_log slow_log;
+
+static std::string json_string(const std::string& text)
+{
+    std::stringstream stream;
+    stream << '"';
+    for(unsigned char c : text)
+    {
+        switch(c)
+        {
+            case '"':  stream << "\\\""; break;
+            case '\\': stream << "\\\\"; break;
+            case '\n': stream << "\\n";  break;
+            case '\t': stream << "\\t";  break;
+            default:
+                if(c < 0x20)
+                {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    stream << escaped;
+                }
+                else
+                    stream << c;
+        }
+    }
+    stream << '"';
+    return stream.str();
+}
+
+// Operators in the order EXPLAIN prints them.
+static void log_operators(std::stringstream& stream, plan_node& node,
+                          table_map_t& tables, int depth, bool& first)
+{
+    std::vector<plan_node*> inputs;
+    auto text = operator_text(node, inputs);
+
+    stream << (first ? "" : ",") << "{\"operator\":" << json_string(text)
+           << ",\"depth\":" << depth
+           << ",\"estimated_rows\":" << (unsigned long long int)estimate_rows(node, tables);
+    if(node.profile)
+    {
+        stream << ",\"rows\":" << node.profile->rows
+               << ",\"build_ms\":" << node.profile->build_time;
+        if(node.profile->index_side >= 0)
+            stream << ",\"index_keys\":" << node.profile->index_keys;
+        if(node.profile->bytes_materialized)
+            stream << ",\"bytes_materialized\":" << node.profile->bytes_materialized;
+    }
+    stream << "}";
+    first = false;
+
+    for(auto* input : inputs)
+        log_operators(stream, *input, tables, depth + 1, first);
+}
+
+void slow_query_log::record(const std::string& query, const std::string& statement,
+                            double milliseconds, plan_node* plan, table_map_t& tables)
+{
+    std::stringstream stream;
+    stream << "{\"time\":" << std::time(nullptr)
+           << ",\"statement\":" << json_string(statement)
+           << ",\"query\":" << json_string(query)
+           << ",\"elapsed_ms\":" << milliseconds
+           << ",\"peak_memory_bytes\":" << metrics.current_query_bytes();
+    if(plan)
+    {
+        bool first = true;
+        stream << ",\"plan\":[";
+        log_operators(stream, *plan, tables, 0, first);
+        stream << "]";
+    }
+    stream << "}\n";
+
+    // One appending write per line, so concurrent
+    // processes logging to the same file don't interleave.
+    int fd = open(file_name.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if(fd < 0)
+    {
+        std::cerr << "Error writing slow query log: " << file_name << std::endl;
+        return;
+    }
+    auto line = stream.str();
+    if(write(fd, line.c_str(), line.size()) != (ssize_t)line.size())
+        std::cerr << "Error writing slow query log: " << file_name << std::endl;
+    close(fd);
+}
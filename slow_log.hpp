@@ -0,0 +1,28 @@
+#ifndef _SLOW_LOG_H
+#define _SLOW_LOG_H
+
+#include <string>
+
+#include "table.hpp"
+
+struct plan_node;
+
+// Statements taking at least threshold ms are appended to file_name
+// as a line of JSON, set by --slow-log FILE and --slow-ms N.
+// With the log on, SELECTs count the rows of each operator,
+// but don't time them.
+struct slow_query_log
+{
+    std::string file_name;
+    double      threshold = 1000;
+
+    bool enabled() { return file_name != ""; }
+
+    // plan is null for statements other than SELECT.
+    void record(const std::string& query, const std::string& statement,
+                double milliseconds, plan_node* plan, table_map_t& tables);
+};
+
+extern slow_query_log slow_log;
+
+#endif
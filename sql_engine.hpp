@@ -4,15 +4,23 @@
 #include <algorithm>
 #include <cstring>
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <queue>
 #include <string>
 #include <unordered_map>
 #include <utility>
 
+#include "catalog.hpp"
+#include "metrics.hpp"
 #include "parser.hpp"
+#include "query_limits.hpp"
+#include "server.hpp"
+#include "shared_tables.hpp"
+#include "slow_log.hpp"
 #include "table.hpp"
 #include "table_views.hpp"
+#include "trace.hpp"
 #include "util.hpp"
 
 #include "query_impl/compile.hpp"
@@ -22,30 +30,71 @@
 // lexing, parsing, compilation, and running of queries.
 
 // Responsible for holding the currently loaded tables
-// to pass to query compilation.
+// to pass to query compilation, in a catalog shared by
+// every engine of a server.
 
 struct sql_engine
 {
-    table_map_t tables;
+    std::shared_ptr<catalog_t> catalog;
     std::vector<token_t> tokens;
 
-    sql_engine() : tables() {};
+    // Text of the statement being lexed, which may span lines.
+    std::string statement;
 
+    sql_engine() : catalog(std::make_shared<catalog_t>()) {};
+    sql_engine(std::shared_ptr<catalog_t> catalog_) : catalog(catalog_) {};
+
+    // Ctrl-C cancels the statement running, see query_limits.hpp.
+    // At the prompt it drops the line being typed, along with the
+    // rest of a statement spanning lines. EXIT or the end of stdin exits.
     void run_shell()
     {
+        watch_interrupts();
         while(1)
         {
             std::string line;
-            std::cout << "> ";
-            std::getline(std::cin, line);
+            std::cout << "> " << std::flush;
+
+            limits.flags->cancelled = false;
+            interrupt_reads(true);
+            bool read = (bool)std::getline(std::cin, line);
+            interrupt_reads(false);
+            if(!read)
+            {
+                if(!limits.flags->cancelled)
+                    break;
+
+                std::cin.clear();
+                clearerr(stdin);
+                tokens.clear();
+                statement.clear();
+                std::cout << std::endl;
+                continue;
+            }
+
             process_line(line);
         }
+        std::cout << std::endl;
+    }
+
+    // Serves queries on a Unix domain socket, see server.hpp. Each query
+    // runs in an engine of it's own sharing our catalog, so queries
+    // run at the same time, and a statement without it's ; is dropped.
+    void serve(const std::string& path)
+    {
+        run_server(path, [this](std::string& query)
+        {
+            sql_engine session(catalog);
+            session.process_line(query);
+        });
     }
 
     void process_line(std::string& line)
     {
         lexer l(line);
         token_t token;
+        auto lex_start = std::chrono::steady_clock::now();
+        unsigned int statement_begin = 0;
         while(l.next_token(token))
         {
             output_token(token);
@@ -53,11 +102,19 @@ struct sql_engine
             {
                 case token_t::INVALID:
                     tokens = std::vector<token_t>();
+                    statement.clear();
+                    statement_begin = l.idx;
                     break;
                 case token_t::END:
                 {
+                    if(tracing)
+                        record_span("lex", lex_start);
+                    statement += line.substr(statement_begin, l.idx - statement_begin);
                     execute_query();
                     tokens.resize(0);
+                    statement.clear();
+                    statement_begin = l.idx;
+                    lex_start = std::chrono::steady_clock::now();
                     break;
                 }
                 default:
@@ -65,37 +122,76 @@ struct sql_engine
                     break;
             }
         }
+
+        if(tokens.size())
+            statement += line.substr(statement_begin) + "\n";
     }
 
     void load_from_csv(std::string& table_name, std::string& file_name)
     {
-        if(tables.find(table_name) != tables.end())
+        auto base = catalog->snapshot();
+        if(base->find(table_name) != base->end())
         {
             std::cerr << "Invalid input: Attempted to load more than one table of the same name."
                       << "    " << table_name;
             throw 0;
         }
 
-        tables.emplace(std::make_pair(table_name, std::make_shared<table>(file_name)));
+        table_map_t tables(*base);
+        tables.emplace(std::make_pair(table_name, load_table(file_name)));
+        if(!catalog->publish(*base, tables))
+            throw 0;
     }
 
     void execute_query()
     {
+        limits.begin();
+        auto base = catalog->snapshot();
+        table_map_t tables(*base);
         try
         {
             auto start = std::chrono::steady_clock::now();
 
-            parse_tree_node p = parse(tokens);
-            auto query = compile_query(p, tables);
-            query->run();
+            parse_tree_node p;
+            std::unique_ptr<query_object> query;
+            {
+                trace_span span("parse");
+                p = parse(tokens);
+            }
+            {
+                trace_span span("compile");
+                query = compile_query(p, tables);
+            }
+            {
+                trace_span span("run");
+                query->run();
+            }
+            if(!catalog->publish(*base, tables))
+                throw 0;
 
             auto end = std::chrono::steady_clock::now();
+            if(tracing)
+                record_span(output_token(p.token), start);
 
-            std::cerr << "Executed command in "
-                      << std::chrono::duration<double, std::milli>(end - start).count()
-                      << "ms." << std::endl;
+            auto milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+            metrics.end_query(output_token(p.token), milliseconds);
+            if(slow_log.enabled() && milliseconds >= slow_log.threshold)
+            {
+                auto begin = statement.find_first_not_of(" \t\n");
+                slow_log.record(begin == std::string::npos ? "" : statement.substr(begin),
+                                output_token(p.token), milliseconds,
+                                query->plan.get(), tables);
+            }
+
+            std::cerr << "Executed command in " << milliseconds << "ms." << std::endl;
         }
-        catch(int) {}
+        catch(int)
+        {
+            metrics.failed++;
+        }
+
+        // After the query is gone, so it's counted everything.
+        metrics.dump(tables);
     }
 };
 
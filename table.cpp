@@ -1,81 +1,775 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <memory>
+#include <sstream>
 #include <vector>
 
+#include "metrics.hpp"
 #include "parse_csv.hpp"
+#include "query_limits.hpp"
+#include "scheduler.hpp"
 #include "table.hpp"
 #include "table_views.hpp"
+#include "trace.hpp"
+
+// Indexes are shared, as they're never changed once built, and
+// stats are loaded atomically, as the planner may be installing them.
+table::table(const table& other)
+    : column_names(other.column_names), column_types(other.column_types),
+      cells(other.cells), width(other.width), height(other.height),
+      zones(other.zones), sorted(other.sorted), indexes(other.indexes),
+      stats(std::atomic_load(&other.stats))
+{
+}
 
 // Reconstruct a table from a file
 table::table(std::string& file_name)
 {
-    std::vector<std::vector<char*>> ir = parse_csv(file_name);
+    trace_span span("load csv");
+    std::vector<std::vector<char*>> ir;
+    {
+        trace_span span("read csv");
+        ir = parse_csv(file_name);
+    }
 
     for(auto name: ir[0])
     {
         column_names.push_back(std::string(name));
     }
 
-    column_types = infer_column_types(ir);
-    cells        = load_from_ir(ir, column_types);
+    // The ir points into one buffer, freed by load_from_ir,
+    // or here if the load fails or is cancelled before that.
+    try
+    {
+        {
+            trace_span span("infer types");
+            column_types = infer_column_types(ir);
+        }
+        {
+            trace_span span("convert cells");
+            for(auto& column : load_from_ir(ir, column_types))
+                cells.emplace_back(std::move(column));
+        }
+    }
+    catch(...)
+    {
+        if(cells.empty())
+            free(ir[0][0]);
+        throw;
+    }
     width        = cells.size();
     height       = cells[0].size();
+
+    build_zones();
+    detect_sorted();
+    if(analyze_on_load)
+        analyze();
 }
 
 // Called from table_view if we want to load
 // a non-trivial table_view from (join, select) into memory,
 // as a concrete table.
 
-// The only use case that requires this currently is for non-trivial joins.
+// The heights of joins and selects are only estimates, and for a
+// cross join can be far more rows than we'll see, so nothing is sized
+// by them. Rows are read into chunks per column, growing from
+// first_chunk_rows to last_chunk_rows, then each column is copied
+// out of it's chunks into exactly sized storage, freeing them as we go.
+static const unsigned int first_chunk_rows = 1 << 12;
+static const unsigned int last_chunk_rows  = 1 << 20;
+
 table::table(table_view& view)
 {
-    cells = std::vector<std::vector<cell>>(view.width(),
-                                           std::vector<cell>(view.height()));
-    int curr_row = 0;
+    trace_span span("materialize");
+    unsigned int columns = view.width();
+    std::vector<std::vector<std::vector<cell>>> chunks(columns);
+
+    unsigned int curr_row = 0, chunk_row = 0, chunk_rows = 0;
     while(!view.empty())
     {
-        for(unsigned int i = 0; i < view.width(); i++)
+        if(chunk_row == chunk_rows)
         {
-            cells[i][curr_row] = view.access_column(i);
+            chunk_rows = chunk_rows ? std::min(2 * chunk_rows, last_chunk_rows)
+                                    : first_chunk_rows;
+            limits.charge((unsigned long long int)chunk_rows * columns * sizeof(cell));
+            for(auto& column : chunks)
+                column.emplace_back(chunk_rows);
+            chunk_row = 0;
+        }
+
+        for(unsigned int i = 0; i < columns; i++)
+        {
+            chunks[i].back()[chunk_row] = view.access_column(i);
         }
         view.advance_row();
+        chunk_row++;
         curr_row++;
     }
-    for(auto& column : cells)
+
+    for(unsigned int i = 0; i < columns; i++)
     {
-        column.resize(curr_row);
+        std::vector<cell> column;
+        column.reserve(curr_row);
+        for(auto& chunk : chunks[i])
+        {
+            auto rows = std::min<size_t>(chunk.size(), curr_row - column.size());
+            column.insert(column.end(), chunk.begin(), chunk.begin() + rows);
+            std::vector<cell>().swap(chunk);
+        }
+        cells.emplace_back(std::move(column));
     }
 
     column_names = view.column_names;
     column_types = view.column_types;
 
-    width        = cells.size();
-    height       = cells[0].size();
+    width        = columns;
+    height       = curr_row;
+
+    build_zones();
+    detect_sorted();
 }
 
+template<typename T>
+static void build_column_zones(const column_t& column,
+                               std::vector<zone_t>& zones)
+{
+    for(unsigned int start = 0; start < column.size(); start += table::zone_rows)
+    {
+        unsigned int end = std::min<unsigned int>(start + table::zone_rows, column.size());
+        T min = *(T*)&column[start], max = min;
+        for(unsigned int i = start + 1; i < end; i++)
+        {
+            T value = *(T*)&column[i];
+            if(value < min) min = value;
+            if(value > max) max = value;
+        }
+
+        zone_t zone;
+        *(T*)&zone.min = min;
+        *(T*)&zone.max = max;
+        zones.push_back(zone);
+    }
+}
+
+// Compute the min and max of each block of each column,
+// allowing scans to skip blocks a filter can't match. Columns in parallel.
+void table::build_zones()
+{
+    trace_span span("zone maps");
+    zones = std::vector<std::vector<zone_t>>(width);
+    parallel_for(width, 1, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            if(column_types[i] == cell_type::INT)
+                build_column_zones<long long int>(cells[i], zones[i]);
+            else
+                build_column_zones<double>(cells[i], zones[i]);
+        }
+    });
+}
+
+// Compares as integers only if both sides are,
+// returns <0, 0, >0 like strcmp.
+static int compare_cells(const cell& left, cell_type left_type,
+                         const cell& right, cell_type right_type)
+{
+    if(left_type == cell_type::INT && right_type == cell_type::INT)
+        return (left.i > right.i) - (left.i < right.i);
+
+    double l = left_type  == cell_type::INT ? (double)left.i  : left.d;
+    double r = right_type == cell_type::INT ? (double)right.i : right.d;
+    return (l > r) - (l < r);
+}
+
+template<typename T>
+static bool column_sorted(const column_t& column)
+{
+    for(unsigned int i = 1; i < column.size(); i++)
+        if(*(T*)&column[i] < *(T*)&column[i-1])
+            return false;
+    return true;
+}
+
+void table::detect_sorted()
+{
+    trace_span span("detect sorted");
+    // Bits of a vector<bool> can't be set from different threads.
+    std::vector<char> column_sorted_flags(width);
+    parallel_for(width, 1, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            if(column_types[i] == cell_type::INT)
+                column_sorted_flags[i] = column_sorted<long long int>(cells[i]);
+            else
+                column_sorted_flags[i] = column_sorted<double>(cells[i]);
+        }
+    });
+    sorted = std::vector<bool>(column_sorted_flags.begin(), column_sorted_flags.end());
+}
+
+template<typename T>
+static void column_range(std::vector<zone_t>& zones, column_stats& stats)
+{
+    T min = *(T*)&zones[0].min, max = *(T*)&zones[0].max;
+    for(auto& zone : zones)
+    {
+        if(*(T*)&zone.min < min) min = *(T*)&zone.min;
+        if(*(T*)&zone.max > max) max = *(T*)&zone.max;
+    }
+    stats.min = *(cell*)&min;
+    stats.max = *(cell*)&max;
+}
+
+// Scrambles the bits of a value, so any of them can be used as a hash.
+static unsigned long long int mix_bits(unsigned long long int x)
+{
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// HyperLogLog over the bits of the values, with 2^14 registers
+// for an error around 1% in 16KB, however many rows there are.
+static unsigned long long int approximate_distinct(const column_t& column)
+{
+    const unsigned int precision = 14, registers = 1 << precision;
+    std::vector<unsigned char> ranks(registers);
+    for(auto& value : column)
+    {
+        // First bits pick the register, which keeps the
+        // longest run of leading zeros in the rest.
+        auto hash = mix_bits(value.i);
+        auto rest = hash << precision;
+        unsigned char rank = 1;
+        while(rank <= 64 - precision && !(rest & (1ULL << 63)))
+        {
+            rest <<= 1;
+            rank++;
+        }
+        auto& current = ranks[hash >> (64 - precision)];
+        if(rank > current)
+            current = rank;
+    }
+
+    double sum = 0;
+    unsigned int empty = 0;
+    for(auto rank : ranks)
+    {
+        sum += std::ldexp(1.0, -rank);
+        empty += !rank;
+    }
+    double alpha    = 0.7213 / (1 + 1.079 / registers);
+    double estimate = alpha * registers * registers / sum;
+
+    // Few values are counted better by the registers they left empty.
+    if(estimate <= 2.5 * registers && empty)
+        estimate = registers * std::log((double)registers / empty);
+
+    return std::min<unsigned long long int>(estimate + 0.5, column.size());
+}
+
+// Evenly spaced sample of up to histogram_sample rows, sorted.
+template<typename T>
+static std::vector<T> column_sample(const column_t& column)
+{
+    unsigned int step = column.size() / table::histogram_sample + 1;
+    std::vector<T> sample;
+    for(unsigned int i = 0; i < column.size(); i += step)
+        sample.push_back(*(T*)&column[i]);
+    std::sort(sample.begin(), sample.end());
+    return sample;
+}
+
+// Distinct values estimated from the sample with the GEE estimator:
+// each value seen once in the sample stands for sqrt(rows / sample)
+// values of the column, values seen more than once for themselves.
+// Exact when the sample is every row. A sample without repeats is
+// more likely of a column of unique values, so it's scaled up to rows.
+template<typename T>
+static unsigned long long int sampled_distinct(const std::vector<T>& sample, size_t rows)
+{
+    unsigned long long int seen = 0, once = 0;
+    for(size_t i = 0; i < sample.size();)
+    {
+        size_t j = i + 1;
+        while(j < sample.size() && !(sample[i] < sample[j]))
+            j++;
+        seen++;
+        once += j - i == 1;
+        i = j;
+    }
+
+    if(once == sample.size())
+        return rows;
+
+    double estimate = std::sqrt((double)rows / sample.size()) * once + (seen - once);
+    return std::min<unsigned long long int>(estimate + 0.5, rows);
+}
+
+// Equal height buckets from the sample.
+template<typename T>
+static void column_histogram(const std::vector<T>& sample, column_stats& stats)
+{
+    stats.histogram = std::vector<cell>(table::histogram_buckets + 1);
+    for(unsigned int i = 0; i < table::histogram_buckets; i++)
+        *(T*)&stats.histogram[i] = sample[(unsigned long long int)i * sample.size()
+                                          / table::histogram_buckets];
+
+    // Rows past the last sampled one may be bigger
+    stats.histogram.back() = stats.max;
+    stats.histogram.front() = stats.min;
+}
+
+template<typename T>
+static void column_stats_impl(const column_t& column, std::vector<zone_t>& zones,
+                              bool sampled, column_stats& stats)
+{
+    column_range<T>(zones, stats);
+    auto sample = column_sample<T>(column);
+    column_histogram<T>(sample, stats);
+    stats.distinct = sampled ? sampled_distinct<T>(sample, column.size())
+                             : approximate_distinct(column);
+    stats.sampled  = sampled;
+}
+
+// Range comes from the zones, and the histogram is built from a
+// sample, a column per task. Distinct values are counted over every
+// row by HyperLogLog, or estimated from the sample if sampled, so
+// they cost the same however many rows there are.
+static std::shared_ptr<const std::vector<column_stats>> compute_stats(table& source,
+                                                                      bool sampled)
+{
+    trace_span span("analyze");
+    auto& zones = source.zones;
+    auto& cells = source.cells;
+    auto stats  = std::make_shared<std::vector<column_stats>>(source.width);
+    if(!source.height)
+        return stats;
+
+    parallel_for(source.width, 1, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            limits.check();
+            if(source.column_types[i] == cell_type::INT)
+                column_stats_impl<long long int>(cells[i], zones[i], sampled, (*stats)[i]);
+            else
+                column_stats_impl<double>(cells[i], zones[i], sampled, (*stats)[i]);
+        }
+    });
+    return stats;
+}
+
+void table::analyze()
+{
+    std::atomic_store(&stats, compute_stats(*this, false));
+}
+
+// Published tables are only analyzed by the planner, which may be
+// planning queries on several threads at once. Each analyzes a sample
+// without a lock, and the first to finish installs it's stats, which
+// ANALYZE replaces with stats of every row.
+const column_stats& table::statistics(unsigned int column)
+{
+    auto current = std::atomic_load(&stats);
+    if(!current)
+    {
+        auto computed = compute_stats(*this, true);
+        if(std::atomic_compare_exchange_strong(&stats, &current, computed))
+            current = computed;
+    }
+    return (*current)[column];
+}
+
+// First row in [begin, end) for which the comparison of
+// the column against value is above threshold.
+static unsigned int partition_point(const column_t& column, cell_type column_type,
+                                    const cell& value, cell_type value_type,
+                                    unsigned int begin, unsigned int end,
+                                    int threshold)
+{
+    while(begin < end)
+    {
+        unsigned int middle = begin + (end - begin) / 2;
+        if(compare_cells(column[middle], column_type, value, value_type) > threshold)
+            end = middle;
+        else
+            begin = middle + 1;
+    }
+    return begin;
+}
+
+bool table::sorted_range(const zone_predicate& predicate,
+                         unsigned int& begin, unsigned int& end)
+{
+    if(!sorted[predicate.column])
+        return false;
+
+    auto& column = cells[predicate.column];
+    auto type    = column_types[predicate.column];
+
+    // Lower bound is the first row >= value, upper bound the first row > value
+    auto lower_bound = [&]() { return partition_point(column, type, predicate.value,
+                                                      predicate.value_type, begin, end, -1); };
+    auto upper_bound = [&]() { return partition_point(column, type, predicate.value,
+                                                      predicate.value_type, begin, end, 0); };
+
+    switch(predicate.op)
+    {
+        case zone_predicate::LESS:          end   = lower_bound(); break;
+        case zone_predicate::LESS_EQUAL:    end   = upper_bound(); break;
+        case zone_predicate::GREATER:       begin = upper_bound(); break;
+        case zone_predicate::GREATER_EQUAL: begin = lower_bound(); break;
+        case zone_predicate::EQUAL:
+        {
+            unsigned int lower = lower_bound();
+            end   = upper_bound();
+            begin = lower;
+            break;
+        }
+    }
+
+    return true;
+}
+
+template<typename T>
+static void sort_rows(const column_t& column, std::vector<unsigned int>& order)
+{
+    std::stable_sort(order.begin(), order.end(),
+                     [&](unsigned int left, unsigned int right)
+                     {
+                         return *(T*)&column[left] < *(T*)&column[right];
+                     });
+}
+
+void table::create_index(std::string& name, unsigned int column)
+{
+    trace_span span("create index");
+    auto start = std::chrono::steady_clock::now();
+    auto index = std::make_shared<table_index>();
+    index->name   = name;
+    index->column = column;
+
+    if(column_types[column] == cell_type::INT)
+        build_hash_index(cells[column], height, index->hash);
+
+    limits.charge((unsigned long long int)height * sizeof(unsigned int));
+    index->order.resize(height);
+    for(unsigned int i = 0; i < height; i++)
+        index->order[i] = i;
+    limits.check();
+    if(column_types[column] == cell_type::INT)
+        sort_rows<long long int>(cells[column], index->order);
+    else
+        sort_rows<double>(cells[column], index->order);
+
+    indexes.push_back(index);
+
+    metrics.add_index_build(std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start).count());
+}
+
+// Rows per morsel of a hash index build, and the partitions
+// of values each morsel's rows are split into.
+static const unsigned int index_morsel_rows = 1 << 16;
+static const unsigned int index_partitions  = 64;
+
+struct keyed_row
+{
+    long long int key;
+    unsigned int  row;
+};
+
+// Roughly what rows more grow an index by, values of them new to it,
+// counted the way index_bytes() counts.
+static unsigned long long int index_growth(size_t rows, size_t values)
+{
+    return rows * sizeof(unsigned int) +
+           values * (sizeof(index_t::value_type) + 2 * sizeof(void*));
+}
+
+// Morsels of rows are split by a hash of their value in parallel, then
+// each partition is indexed in parallel, reading the morsels in order.
+// Values are in one partition, so they only go into the index once.
+// What's added is charged to the statement as it's added, so an index
+// over memory_limit fails at most a morsel's partition past it.
+void build_hash_index(const column_t& column, unsigned int rows, index_t& index)
+{
+    if(rows <= index_morsel_rows || scheduler.threads() == 1)
+    {
+        size_t charged_rows = 0, charged_values = 0;
+        for(unsigned int i = 0; i < rows; i++)
+        {
+            if(i % query_limits::check_rows == 0)
+            {
+                limits.check();
+                limits.charge(index_growth(i - charged_rows, index.size() - charged_values));
+                charged_rows   = i;
+                charged_values = index.size();
+            }
+            index[column[i].i].push_back(i);
+        }
+        limits.charge(index_growth(rows - charged_rows, index.size() - charged_values));
+        return;
+    }
+
+    unsigned int morsels = (rows + index_morsel_rows - 1) / index_morsel_rows;
+    std::vector<std::vector<std::vector<keyed_row>>> split(morsels,
+        std::vector<std::vector<keyed_row>>(index_partitions));
+    parallel_for(rows, index_morsel_rows, [&](size_t begin, size_t end)
+    {
+        limits.check();
+        limits.charge((end - begin) * sizeof(keyed_row));
+        auto& partitions = split[begin / index_morsel_rows];
+        for(size_t i = begin; i < end; i++)
+        {
+            auto key = column[i].i;
+            auto partition = ((unsigned long long int)key * 0x9e3779b97f4a7c15ULL) >> 58;
+            partitions[partition].push_back(keyed_row{ key, (unsigned int)i });
+        }
+    });
+
+    std::vector<index_t> partials(index_partitions);
+    parallel_for(index_partitions, 1, [&](size_t begin, size_t end)
+    {
+        for(size_t partition = begin; partition < end; partition++)
+        {
+            auto& partial = partials[partition];
+            for(auto& morsel : split)
+            {
+                limits.check();
+                size_t values = partial.size();
+                for(auto& keyed : morsel[partition])
+                    partial[keyed.key].push_back(keyed.row);
+                limits.charge(index_growth(morsel[partition].size(), partial.size() - values));
+                std::vector<keyed_row>().swap(morsel[partition]);
+            }
+        }
+    });
+
+    size_t values = 0;
+    for(auto& partial : partials)
+        values += partial.size();
+    limits.charge(values * sizeof(void*));
+    index.reserve(values);
+    for(auto& partial : partials)
+    {
+        for(auto& value : partial)
+            index.emplace(value.first, std::move(value.second));
+        index_t().swap(partial);
+    }
+}
+
+unsigned long long int index_bytes(index_t& index)
+{
+    unsigned long long int bytes = index.bucket_count() * sizeof(void*);
+    for(auto& rows : index)
+        bytes += sizeof(rows) + sizeof(void*) + rows.second.capacity() * sizeof(unsigned int);
+    return bytes;
+}
+
+// Cells, zones and indexes, ignoring the small stuff.
+unsigned long long int table::memory_bytes()
+{
+    unsigned long long int bytes = 0;
+    for(auto& column : cells)
+        bytes += column.size() * sizeof(cell);
+    for(auto& column : zones)
+        bytes += column.capacity() * sizeof(zone_t);
+    for(auto& index : indexes)
+        bytes += index_bytes(index->hash) + index->order.capacity() * sizeof(unsigned int);
+    return bytes;
+}
+
+table_index* table::find_index(unsigned int column)
+{
+    for(auto& index : indexes)
+        if(index->column == column)
+            return index.get();
+    return nullptr;
+}
+
+// First position in [begin, end) of the index order for which the
+// comparison of the row's value against value is above threshold.
+static unsigned int index_partition_point(const column_t& column, cell_type column_type,
+                                          std::vector<unsigned int>& order,
+                                          const cell& value, cell_type value_type,
+                                          unsigned int begin, unsigned int end,
+                                          int threshold)
+{
+    while(begin < end)
+    {
+        unsigned int middle = begin + (end - begin) / 2;
+        if(compare_cells(column[order[middle]], column_type, value, value_type) > threshold)
+            end = middle;
+        else
+            begin = middle + 1;
+    }
+    return begin;
+}
+
+bool table::index_rows(const zone_predicate& predicate,
+                       std::vector<unsigned int>& rows)
+{
+    auto index = find_index(predicate.column);
+    if(!index)
+        return false;
+
+    auto& column = cells[predicate.column];
+    auto type    = column_types[predicate.column];
+
+    if(predicate.op == zone_predicate::EQUAL && index->hash.size())
+    {
+        auto found = index->hash.find(predicate.value.i);
+        if(found != index->hash.end())
+            rows = found->second;
+        else
+            rows.clear();
+        return true;
+    }
+
+    unsigned int begin = 0, end = height;
+    auto lower_bound = [&]() { return index_partition_point(column, type, index->order,
+                                                            predicate.value, predicate.value_type,
+                                                            begin, end, -1); };
+    auto upper_bound = [&]() { return index_partition_point(column, type, index->order,
+                                                            predicate.value, predicate.value_type,
+                                                            begin, end, 0); };
+    switch(predicate.op)
+    {
+        case zone_predicate::LESS:          end   = lower_bound(); break;
+        case zone_predicate::LESS_EQUAL:    end   = upper_bound(); break;
+        case zone_predicate::GREATER:       begin = upper_bound(); break;
+        case zone_predicate::GREATER_EQUAL: begin = lower_bound(); break;
+        case zone_predicate::EQUAL:
+        {
+            unsigned int lower = lower_bound();
+            end   = upper_bound();
+            begin = lower;
+            break;
+        }
+    }
+
+    // Visiting rows out of order is slower than scanning
+    // once we'd visit much of the table.
+    if(end - begin > height / 8)
+        return false;
+
+    rows.assign(index->order.begin() + begin, index->order.begin() + end);
+    std::sort(rows.begin(), rows.end());
+    return true;
+}
+
+// Whether any row in the zone could satisfy column op value
+bool zone_predicate::may_match(const zone_t& zone, cell_type column_type) const
+{
+    switch(op)
+    {
+        case LESS:
+            return compare_cells(zone.min, column_type, value, value_type) < 0;
+        case LESS_EQUAL:
+            return compare_cells(zone.min, column_type, value, value_type) <= 0;
+        case GREATER:
+            return compare_cells(zone.max, column_type, value, value_type) > 0;
+        case GREATER_EQUAL:
+            return compare_cells(zone.max, column_type, value, value_type) >= 0;
+        case EQUAL:
+            return compare_cells(zone.min, column_type, value, value_type) <= 0 &&
+                   compare_cells(zone.max, column_type, value, value_type) >= 0;
+    }
+
+    return true;
+}
+
+static void print_cell(std::ostream& out, const cell& value, cell_type type)
+{
+    if(type == cell_type::INT)
+        out << value.i;
+    else
+        out << value.d;
+}
+
+// Statistics are shown once the table has been analyzed by ANALYZE,
+// not while it only has the planner's estimates from a sample.
 void table::describe()
 {
-    std::cout << std::setw(15) << std::left << "Column" << " | "
-        << std::setw(15) << std::left << "Type"   << std::endl;
-    std::cout << std::string(16, '-') << "+" << std::string(16, '-') << std::endl;
+    auto current  = std::atomic_load(&stats);
+    bool analyzed = current && height && !current->front().sampled;
+
+    // Formatted apart from std::cout, which connections share, see server.hpp.
+    std::ostringstream out;
+
+    out << std::setw(15) << std::left << "Column" << " | "
+    << std::setw(15) << std::left << "Type"   << " | "
+    << std::setw(15) << std::left << "Sorted";
+    if(analyzed)
+        out << " | " << std::setw(15) << std::left << "Distinct"
+            << " | " << std::setw(15) << std::left << "Min"
+            << " | " << std::setw(15) << std::left << "Max";
+    out << std::endl;
+    out << std::string(16, '-') << "+" << std::string(17, '-')
+        << "+" << std::string(16, '-');
+    if(analyzed)
+        out << "-+" << std::string(17, '-') << "+" << std::string(17, '-')
+            << "+" << std::string(16, '-');
+    out << std::endl;
     for(unsigned int i = 0; i < column_names.size(); i++)
     {
-        std::cout << std::setw(15) << column_names[i] << " | ";
+        out << std::setw(15) << column_names[i] << " | ";
         switch(column_types[i])
         {
             case cell_type::INT:
-                std::cout << std::setw(15) << std::left << "long long int" << std::endl;
+                out << std::setw(15) << std::left << "long long int";
                 break;
             case cell_type::FLOAT:
-                std::cout << std::setw(15) << std::left << "double" << std::endl;
+                out << std::setw(15) << std::left << "double";
                 break;
             default: break;
         }
+        out << " | " << std::setw(15) << std::left
+            << (sorted[i] ? "yes" : "no");
+        if(analyzed)
+        {
+            out << " | " << std::setw(15) << std::left << (*current)[i].distinct << " | "
+                << std::setw(15);
+            print_cell(out, (*current)[i].min, column_types[i]);
+            out << " | " << std::setw(15);
+            print_cell(out, (*current)[i].max, column_types[i]);
+        }
+        out << std::endl;
+    }
+
+    if(analyzed)
+    {
+        out << std::endl << height << " rows" << std::endl;
+        for(unsigned int i = 0; i < width; i++)
+        {
+            out << "Histogram of " << column_names[i] << ":";
+            for(auto& bound : (*current)[i].histogram)
+            {
+                out << " ";
+                print_cell(out, bound, column_types[i]);
+            }
+            out << std::endl;
+        }
+    }
+
+    for(auto& index : indexes)
+    {
+        out << std::endl << "Index " << index->name
+            << " on " << column_names[index->column];
     }
+    if(indexes.size())
+        out << std::endl;
 
-    std::cout << std::endl << std::endl;
+    out << std::endl << std::endl;
+    std::cout << out.str() << std::flush;
 }
 
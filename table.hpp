@@ -34,17 +34,169 @@ struct cell
 
 struct table_view;
 
+// Values of a column, which never change once the table is built.
+// Versions of a table share them, see catalog.hpp, and tables attached
+// from shared memory point them into the mapping, see shared_tables.hpp.
+struct column_t
+{
+    column_t() = default;
+    column_t(std::vector<cell>&& column)
+    {
+        auto stored = std::make_shared<const std::vector<cell>>(std::move(column));
+        values = stored->data();
+        length = stored->size();
+        owner  = std::move(stored);
+    }
+
+    // Values owned by whatever owner keeps alive.
+    column_t(std::shared_ptr<const void> owner, const cell* values, size_t length)
+        : owner(std::move(owner)), values(values), length(length) {}
+
+    const cell& operator[](size_t i) const { return values[i]; }
+    const cell* data()  const { return values; }
+    const cell* begin() const { return values; }
+    const cell* end()   const { return values + length; }
+    size_t      size()  const { return length; }
+
+private:
+    std::shared_ptr<const void> owner;
+    const cell*                 values = nullptr;
+    size_t                      length = 0;
+};
+
+// Min and max of a column over a block of rows.
+struct zone_t
+{
+    cell min;
+    cell max;
+};
+
+// A comparison of a column against a constant, that
+// can rule out blocks of rows by their zone.
+struct zone_predicate
+{
+    enum comparison
+    {
+        LESS,
+        LESS_EQUAL,
+        GREATER,
+        GREATER_EQUAL,
+        EQUAL,
+    };
+
+    unsigned int column;
+    comparison   op;
+    cell         value;
+    cell_type    value_type;
+
+    bool may_match(const zone_t& zone, cell_type column_type) const;
+};
+
+typedef std::unordered_map<long long int,
+                           std::vector<unsigned int>> index_t;
+
+// Approximate memory held by an index, with it's nodes and buckets.
+unsigned long long int index_bytes(index_t& index);
+
+// Indexes the first rows of an integer column into an empty index.
+// Morsels of rows are indexed in parallel, then merged in order,
+// so the rows of each value stay ascending.
+void build_hash_index(const column_t& column, unsigned int rows, index_t& index);
+
+// Index on a column of a table, built by CREATE_INDEX
+// and kept with the table.
+struct table_index
+{
+    std::string  name;
+    unsigned int column;
+
+    // Value -> rows, for joins and equality. Integer columns only.
+    index_t hash;
+
+    // Rows ordered by value, then row, for ranges.
+    std::vector<unsigned int> order;
+};
+
+// Statistics of a column, for the planner to estimate
+// how many rows filters and joins produce.
+struct column_stats
+{
+    cell                   min, max;
+
+    // Approximate, counted by HyperLogLog, or estimated from
+    // a sample when the planner analyzed the table itself.
+    unsigned long long int distinct;
+
+    // Bounds of buckets holding an equal number of rows,
+    // from the min to the max, so histogram_buckets + 1 of them.
+    std::vector<cell>      histogram;
+
+    // Whether the planner estimated them from a sample, rather
+    // than ANALYZE computing them, see table::statistics().
+    bool                   sampled;
+};
+
+// Set by --analyze, to analyze tables as they're loaded.
+extern bool analyze_on_load;
+
 struct table
 {
+    // Rows per block in the zone maps.
+    static const unsigned int zone_rows = 4096;
+
+    // Buckets per column histogram, and the most rows analyze()
+    // samples to build them.
+    static const unsigned int histogram_buckets = 16;
+    static const unsigned int histogram_sample  = 32768;
+
     std::vector<std::string>        column_names;
     std::vector<cell_type>          column_types;
-    std::vector<std::vector<cell>>  cells;
+    std::vector<column_t>           cells;
     unsigned int                    width, height;
 
+    // Per column, per block of zone_rows rows.
+    std::vector<std::vector<zone_t>> zones;
+
+    // Per column, whether it's values never decrease.
+    std::vector<bool> sorted;
+
+    std::vector<std::shared_ptr<table_index>> indexes;
+
+    // Per column, null until analyze() is called, by ANALYZE
+    // or the planner. Only loaded and stored atomically, as the
+    // planner may install them while other queries read the table.
+    std::shared_ptr<const std::vector<column_stats>> stats;
+
     table() = default;
+
+    // A new version of the table, see catalog.hpp, sharing it's cells.
+    table(const table& other);
     table(std::string& file_name);
     table(table_view& view);
     void describe();
+    unsigned long long int memory_bytes();
+    void build_zones();
+    void detect_sorted();
+    void analyze();
+
+    // Stats of the column, analyzing a sample of the table the first time
+    // they're needed. Queries running at the same time can share the table,
+    // so the first stats installed are kept, and stay valid with it.
+    const column_stats& statistics(unsigned int column);
+
+    // Narrow [begin, end) to the rows satisfying predicate by binary
+    // search. Returns false if the predicate's column isn't sorted.
+    bool sorted_range(const zone_predicate& predicate,
+                      unsigned int& begin, unsigned int& end);
+
+    void create_index(std::string& name, unsigned int column);
+    table_index* find_index(unsigned int column);
+
+    // Rows satisfying predicate in ascending order, looked up in an index.
+    // Returns false if there's no index on the column, or it's not selective
+    // enough to beat a scan.
+    bool index_rows(const zone_predicate& predicate,
+                    std::vector<unsigned int>& rows);
 };
 
 typedef std::unordered_map<std::string, std::shared_ptr<table>> table_map_t;
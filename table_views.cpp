@@ -1,14 +1,21 @@
+#include <algorithm>
+#include <chrono>
 
+#include "metrics.hpp"
+#include "query_limits.hpp"
 #include "table_views.hpp"
+#include "trace.hpp"
 
-#include "query_impl/as.hpp"
+#include "query_impl/plan.hpp"
 #include "query_impl/select.hpp"
 
 table_iterator::table_iterator(const table_iterator& other) : table_view()
 {
     current_row = 0;
+    begin_row = 0;
     name = other.name;
     source = other.source;
+    end_row = source->height;
     column_names = other.column_names;
     column_types = other.column_types;
 }
@@ -18,7 +25,9 @@ table_iterator::table_iterator(const table_iterator& other) : table_view()
 table_iterator::table_iterator(table_view& view) : table_view()
 {
     current_row = 0;
+    begin_row = 0;
     source = std::make_shared<table>(view);
+    end_row = source->height;
     name = view.name;
     column_names = source->column_names;
     column_types = source->column_types;
@@ -39,6 +48,8 @@ table_iterator::table_iterator(parse_tree_node& node,
         std::cerr << "Could not resolve table " << id.id << std::endl;
         throw 0;
     }
+    begin_row = 0;
+    end_row = source->height;
     name = id.id;
     column_names = table->second->column_names;
     column_types = table->second->column_types;
@@ -49,19 +60,118 @@ cell table_iterator::access_column(unsigned int i)
     return source->cells[i][current_row];
 }
 
+table_iterator::~table_iterator()
+{
+    metrics.rows_scanned += rows_read;
+}
+
 void table_iterator::advance_row()
 {
+    if(++rows_read % query_limits::check_rows == 0)
+        limits.check();
+    if(use_index_rows)
+    {
+        index_position++;
+        current_row = index_position < index_rows.size() &&
+                      index_rows[index_position] < end_row ?
+                            index_rows[index_position] : end_row;
+        return;
+    }
+
     current_row++;
+    if(zone_filters.size() && current_row % table::zone_rows == 0)
+        skip_blocks();
 }
 
 void table_iterator::reset()
 {
-    current_row = 0;
+    current_row = begin_row;
+    if(use_index_rows)
+        seek_index_rows();
+    else if(zone_filters.size())
+        skip_blocks();
+}
+
+// Predicates on sorted columns narrow the range of rows
+// we iterate over by binary search. Of those on indexed
+// columns, we visit only the rows of the most selective.
+// The rest are checked against the zones of each block.
+void table_iterator::prune_rows(std::vector<zone_predicate>& predicates)
+{
+    for(auto& predicate : predicates)
+    {
+        if(source->sorted_range(predicate, begin_row, end_row))
+            continue;
+
+        std::vector<unsigned int> rows;
+        if(source->index_rows(predicate, rows))
+        {
+            if(!use_index_rows || rows.size() < index_rows.size())
+                index_rows.swap(rows);
+            use_index_rows = true;
+            continue;
+        }
+
+        zone_filters.push_back(predicate);
+    }
+
+    if(current_row < begin_row)
+        current_row = begin_row;
+    if(use_index_rows)
+        seek_index_rows();
+    else if(zone_filters.size())
+        skip_blocks();
+}
+
+// Move to the first index row at or after the current row.
+void table_iterator::seek_index_rows()
+{
+    index_position = std::lower_bound(index_rows.begin(), index_rows.end(), current_row)
+                        - index_rows.begin();
+    current_row = index_position < index_rows.size() &&
+                  index_rows[index_position] < end_row ?
+                        index_rows[index_position] : end_row;
+}
+
+index_t* table_iterator::find_index(unsigned int column)
+{
+    if(begin_row != 0 || end_row != source->height ||
+       use_index_rows || zone_filters.size())
+        return nullptr;
+
+    auto index = source->find_index(column);
+    if(!index || !index->hash.size())
+        return nullptr;
+    return &index->hash;
+}
+
+// Move to the next row in a block that may contain matching rows.
+void table_iterator::skip_blocks()
+{
+    while(current_row < end_row)
+    {
+        unsigned int block = current_row / table::zone_rows;
+        bool may_match = true;
+        for(auto& filter : zone_filters)
+        {
+            if(!filter.may_match(source->zones[filter.column][block],
+                                 source->column_types[filter.column]))
+            {
+                may_match = false;
+                break;
+            }
+        }
+        if(may_match)
+            return;
+
+        current_row = (block + 1) * table::zone_rows;
+    }
+    current_row = end_row;
 }
 
 bool table_iterator::empty()
 {
-    return current_row == source->height;
+    return current_row >= end_row;
 }
 
 unsigned int table_iterator::width()
@@ -109,7 +219,10 @@ struct indexed_join : table_view
     std::shared_ptr<table_iterator> right;
     int left_column, right_column;
 
-    index_t index;
+    // Either the persistent index of the indexed side,
+    // or one we built for this join.
+    index_t built_index;
+    index_t* index;
     index_side side;
 
     // Dummy to initialize iterator variables
@@ -117,6 +230,15 @@ struct indexed_join : table_view
     std::vector<unsigned int>::iterator index_cache;
     std::vector<unsigned int>::iterator empty_cache;
 
+    // A skewed key emits many rows per row scanned,
+    // so the limits are checked by rows emitted too.
+    unsigned long long int rows_emitted = 0;
+    void check_limits()
+    {
+        if(++rows_emitted % query_limits::check_rows == 0)
+            limits.check();
+    }
+
     indexed_join(std::shared_ptr<table_iterator> left_,
                  std::shared_ptr<table_iterator> right_,
                  on_t& on, index_side side_) : table_view(), left(left_),
@@ -141,10 +263,16 @@ struct indexed_join : table_view
             throw 0;
         }
 
-        // If we can, index the smaller side
+        // If we can, use a side with a persistent index,
+        // otherwise index the smaller side
         if(side_ == HEIGHT)
         {
-            side = left->height() > right->height() ? RIGHT : LEFT;
+            if(right->find_index(right_column))
+                side = RIGHT;
+            else if(left->find_index(left_column))
+                side = LEFT;
+            else
+                side = left->height() > right->height() ? RIGHT : LEFT;
         }
         else
         {
@@ -166,18 +294,18 @@ struct indexed_join : table_view
             iterator_column = left_column;
         }
 
-        for(unsigned int i = 0; i < indexed_side->height(); i++)
+        index = indexed_side->find_index(indexed_column);
+        if(!index)
         {
-            auto index_cell = indexed_side->source->cells[indexed_column][i];
-            auto found = index.find(index_cell.i);
-            if(found == index.end())
-            {
-                index.emplace(make_pair(index_cell.i, std::vector<unsigned int>{i}));
-            }
-            else
-            {
-                found->second.push_back(i);
-            }
+            trace_span span("build join index");
+            auto start = std::chrono::steady_clock::now();
+            index = &built_index;
+            build_hash_index(indexed_side->source->cells[indexed_column],
+                             indexed_side->height(), built_index);
+
+            metrics.rows_scanned += indexed_side->height();
+            metrics.add_index_build(std::chrono::duration<double, std::milli>(
+                                        std::chrono::steady_clock::now() - start).count());
         }
 
         column_types.insert(column_types.end(),
@@ -204,8 +332,8 @@ struct indexed_join : table_view
 
         }
 
-        auto found = index.find(iterator_side->access_column(iterator_column).i);
-        if(found != index.end())
+        auto found = index->find(iterator_side->access_column(iterator_column).i);
+        if(found != index->end())
         {
             index_cache = found->second.begin();
             empty_cache = found->second.end();
@@ -223,19 +351,19 @@ struct indexed_join : table_view
     }
 };
 
-// Index the smaller side, iterate over the larger side
-// and until we find rows that match with the index.
+// Index the smaller side, unless the planner chose a side, iterate
+// over the other side until we find rows that match with the index.
 struct inner_join : indexed_join
 {
     inner_join(std::shared_ptr<table_iterator> left_,
                std::shared_ptr<table_iterator> right_,
-               on_t on) : indexed_join(left_, right_, on, HEIGHT)
+               on_t on, index_side side_ = HEIGHT) : indexed_join(left_, right_, on, side_)
     {
         // Need to do first lookup in constructor.
         while(!iterator_side->empty())
         {
-            auto found = index.find(iterator_side->access_column(iterator_column).i);
-            if(found != index.end())
+            auto found = index->find(iterator_side->access_column(iterator_column).i);
+            if(found != index->end())
             {
                 index_cache = found->second.begin();
                 empty_cache   = found->second.end();
@@ -261,6 +389,8 @@ struct inner_join : indexed_join
 
     void advance_row() override
     {
+        check_limits();
+
         // If the last lookup has run out of indicies
         if(++index_cache == empty_cache)
         {
@@ -268,8 +398,8 @@ struct inner_join : indexed_join
             iterator_side->advance_row();
             while(!iterator_side->empty())
             {
-                auto found = index.find(iterator_side->access_column(iterator_column).i);
-                if(found != index.end())
+                auto found = index->find(iterator_side->access_column(iterator_column).i);
+                if(found != index->end())
                 {
                     index_cache = found->second.begin();
                     empty_cache   = found->second.end();
@@ -282,7 +412,7 @@ struct inner_join : indexed_join
 
     bool empty() override
     {
-        return index.size() == 0 || iterator_side->empty();
+        return index->size() == 0 || iterator_side->empty();
     }
 
     unsigned int width() override
@@ -366,6 +496,7 @@ struct outer_join : indexed_join
 
     void advance_row() override
     {
+        check_limits();
         if(!iterator_side->empty())
         {
             // If we don't have any match rows to iterate over
@@ -374,8 +505,8 @@ struct outer_join : indexed_join
                 iterator_side->advance_row();
                 if(!iterator_side->empty())
                 {
-                    auto found = index.find(iterator_side->access_column(iterator_column).i);
-                    if(found != index.end())
+                    auto found = index->find(iterator_side->access_column(iterator_column).i);
+                    if(found != index->end())
                     {
                         index_cache = found->second.begin();
                         empty_cache = found->second.end();
@@ -424,14 +555,16 @@ struct sided_join : indexed_join
 
     void advance_row() override
     {
+        check_limits();
+
         // Iterate over matching rows if we've lookup them up already
         if(index_cache == empty_cache || ++index_cache == empty_cache)
         {
             iterator_side->advance_row();
             if(!iterator_side->empty())
             {
-                auto found = index.find(left->access_column(left_column).i);
-                if(found != index.end())
+                auto found = index->find(iterator_side->access_column(iterator_column).i);
+                if(found != index->end())
                 {
                     index_cache = found->second.begin();
                     empty_cache = found->second.end();
@@ -442,7 +575,7 @@ struct sided_join : indexed_join
 
     bool empty() override
     {
-        return index.size() == 0 || iterator_side->empty();
+        return index->size() == 0 || iterator_side->empty();
     }
     unsigned int width() override
     {
@@ -521,6 +654,13 @@ struct cross_join : table_view
                std::shared_ptr<table_iterator> right_) : table_view(),
                                                          left(left_), right(right_)
     {
+        column_types.insert(column_types.end(),
+                            left->column_types.begin(),
+                            left->column_types.end());
+        column_types.insert(column_types.end(),
+                            right->column_types.begin(),
+                            right->column_types.end());
+
         for(auto& col_name : left->column_names)
         {
              if(left->name != "")
@@ -580,107 +720,188 @@ struct cross_join : table_view
     }
 };
 
-// Implemented logic to generate views when necessary from our parse_tree
-view_factory::view_factory(parse_tree_node& node, table_map_t& tables)
+// Adds the time until it goes out of scope to total.
+struct profile_timer
 {
-    switch(node.token.t)
+    double& total;
+    std::chrono::steady_clock::time_point start;
+
+    profile_timer(double& total_) : total(total_),
+                                    start(std::chrono::steady_clock::now()) {};
+    ~profile_timer()
     {
-        case token_t::AS:
+        total += std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// Wraps the view of a plan node for EXPLAIN ANALYZE or the slow
+// query log, counting the rows it produces. Only advancing and loading is timed, as
+// that's where views do their work, and the clock isn't free.
+struct profiled_view : table_view
+{
+    std::shared_ptr<table_view>   view;
+    std::shared_ptr<plan_profile> profile;
+
+    profiled_view(std::shared_ptr<table_view> view_,
+                  std::shared_ptr<plan_profile> profile_) : table_view(), view(view_),
+                                                            profile(profile_)
+    {
+        name         = view->name;
+        column_names = view->column_names;
+        column_types = view->column_types;
+    }
+
+    cell access_column(unsigned int i) override
+    {
+        return view->access_column(i);
+    }
+
+    void advance_row() override
+    {
+        profile->rows++;
+        if(!profile->timed)
         {
-            if(node.args.size() != 2)
-            {
-                std::cerr << "INTERNAL: Not enough args to AS." << std::endl;
-                throw 0;
-            }
-            as_t<view_factory> a(node, tables);
-            view = a.value.view;
-            view->name = a.name;
+            view->advance_row();
+            return;
+        }
+
+        profile_timer timer(profile->run_time);
+        view->advance_row();
+    }
+
+    bool empty() override
+    {
+        return view->empty();
+    }
+
+    unsigned int width() override
+    {
+        return view->width();
+    }
+
+    unsigned int height() override
+    {
+        return view->height();
+    }
+
+    // Only tables are loaded without copying their rows.
+    std::shared_ptr<table_iterator> load() override
+    {
+        profile_timer timer(profile->run_time);
+        auto loaded = view->load();
+        profile->rows += loaded->height();
+        if(!std::dynamic_pointer_cast<table_iterator>(view))
+            profile->bytes_materialized += (unsigned long long int)loaded->height() *
+                                           loaded->width() * sizeof(cell);
+        return loaded;
+    }
+
+    void prune_rows(std::vector<zone_predicate>& predicates) override
+    {
+        view->prune_rows(predicates);
+    }
+};
+
+// Physical planning, instantiates the views of the nodes of our logical plan.
+view_factory::view_factory(plan_node& node, table_map_t& tables)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    switch(node.type)
+    {
+        case plan_node::SCAN:
+        {
+            view = std::make_shared<table_iterator>(node.table_id, tables);
             break;
         }
-        case token_t::IDENTITIFER:
+        case plan_node::FILTER:
         {
-            view = std::make_shared<table_iterator>(node, tables);
+            from_t from(*node.children[0], tables);
+            parse_tree_node where_node(token_t(token_t::WHERE), node.predicates);
+            view = std::make_shared<filter_view>(from, where_node);
             break;
         }
-        case token_t::OUTER_JOIN:
-        case token_t::INNER_JOIN:
-        case token_t::LEFT_JOIN:
-        case token_t::RIGHT_JOIN:
+        case plan_node::JOIN:
         {
-            if(node.args.size() != 3)
-            {
-                std::cerr << "Not enough args to " << output_token(node.token)
-                          << ". (perhaps ON required>)" << std::endl;
-                throw 0;
-            }
+            trace_span span("join");
 
-            on_t on(node.args[0]);
             // We need to be able to index by row,
             // So just a concrete in memory table representation
             // If they're not already concrete tables
             // We don't have to do this necessarily,
             // but the logic to support row indexing from arbitary
             // select or joins is too complicated.
-            auto left_container     = view_factory(node.args[2], tables);
+            on_t on;
+            if(node.join_type.t != token_t::CROSS_JOIN)
+                on = on_t(node.on);
+
+            auto left_container     = view_factory(*node.children[0], tables);
             auto left_view          = left_container.view;
             auto left_side          = left_view->load();
 
-            auto right_container    = view_factory(node.args[1], tables);
+            auto right_container    = view_factory(*node.children[1], tables);
             auto right_view         = right_container.view;
             auto right_side         = right_view->load();
 
-            if(node.token.t == token_t::OUTER_JOIN)
+            if(node.join_type.t == token_t::OUTER_JOIN)
             {
                 view = std::shared_ptr<table_view>(
                             new outer_join(left_side, right_side, on));
             }
-            if(node.token.t == token_t::INNER_JOIN)
+            if(node.join_type.t == token_t::INNER_JOIN)
             {
+                auto side = node.build_side == 0 ? indexed_join::LEFT  :
+                            node.build_side == 1 ? indexed_join::RIGHT :
+                                                   indexed_join::HEIGHT;
                 view = std::shared_ptr<table_view>(
-                            new inner_join(left_side, right_side, on));
+                            new inner_join(left_side, right_side, on, side));
             }
-            if(node.token.t == token_t::LEFT_JOIN)
+            if(node.join_type.t == token_t::LEFT_JOIN)
             {
                 view = std::shared_ptr<table_view>(
                             new left_outer_join(left_side, right_side, on));
             }
-            if(node.token.t == token_t::RIGHT_JOIN)
+            if(node.join_type.t == token_t::RIGHT_JOIN)
             {
                 view = std::shared_ptr<table_view>(
                             new right_outer_join(left_side, right_side, on));
             }
-            break;
-        }
-        case token_t::CROSS_JOIN:
-        {
-            if(node.args.size() != 2)
+            // Cross joins don't necessarily need to load their sides,
+            // but we do need to reset, just load them for now
+            if(node.join_type.t == token_t::CROSS_JOIN)
             {
-                std::cerr << "INTERNAL: Not enough args to CROSS_JOIN." << std::endl;
-                throw 0;
+                view = std::shared_ptr<table_view>(new cross_join(left_side, right_side));
             }
-
-            // Don't necessarily need to load these guys, but
-            // we do need to reset, just load them for now
-            auto left_container     = view_factory(node.args[0], tables);
-            auto left_view          = left_container.view;
-            auto left_side          = left_view->load();
-
-            auto right_container    = view_factory(node.args[1], tables);
-            auto right_view         = right_container.view;
-            auto right_side         = right_view->load();
-
-            view = std::shared_ptr<table_view>(new cross_join(left_side, right_side));
             break;
         }
-        case token_t::SELECT:
+        case plan_node::PROJECT:
+        case plan_node::AGGREGATE:
         {
             view = select_factory(node, tables);
             break;
         }
         default:
         {
-            std::cerr << "Unexpected argument to FROM." << std::endl;
+            std::cerr << "INTERNAL: Unexpected plan node in FROM." << std::endl;
             throw 0;
         }
     }
+
+    view->name = node.name;
+
+    if(node.profile)
+    {
+        auto join = dynamic_cast<indexed_join*>(view.get());
+        if(join)
+        {
+            node.profile->index_side       = join->side;
+            node.profile->persistent_index = join->index != &join->built_index;
+            node.profile->index_keys       = join->index->size();
+        }
+
+        node.profile->build_time = std::chrono::duration<double, std::milli>(
+                                    std::chrono::steady_clock::now() - start).count();
+        view = std::make_shared<profiled_view>(view, node.profile);
+    }
 }
@@ -17,10 +17,8 @@
 // and necessary information.
 
 
-typedef std::unordered_map<long long int,
-                           std::vector<unsigned int>> index_t;
-
 struct table_iterator;
+struct plan_node;
 
 struct table_view
 {
@@ -37,6 +35,10 @@ struct table_view
     virtual std::shared_ptr<table_iterator> load() = 0;
     virtual ~table_view() = default;
 
+    // Filters on our columns that must hold for a row to be used.
+    // Views that can skip rows cheaply based on them may do so.
+    virtual void prune_rows(std::vector<zone_predicate>&) {}
+
     unsigned int resolve_column(std::string column_name)
     {
         if(name != "")
@@ -69,10 +71,27 @@ struct table_iterator : table_view
 {
     unsigned int            current_row;
     std::shared_ptr<table>  source;
+
+    // Range of rows left after pruning on sorted columns.
+    unsigned int            begin_row, end_row;
+
+    // Blocks of rows whose zones fail any of these are skipped.
+    std::vector<zone_predicate> zone_filters;
+
+    // If a filter could be looked up in an index, we only
+    // visit the rows it found, rather than scanning.
+    bool                      use_index_rows = false;
+    std::vector<unsigned int> index_rows;
+    unsigned int              index_position;
+
+    // Counted into the metrics when we're done.
+    unsigned long long int    rows_read = 0;
+
     table_iterator(const table_iterator& other);
     table_iterator(table_view& view);
     table_iterator(parse_tree_node& node,
                    table_map_t& tables);
+    ~table_iterator();
 
     cell access_column(unsigned int i) override;
     void advance_row() override;
@@ -80,7 +99,15 @@ struct table_iterator : table_view
     unsigned int width() override;
     unsigned int height() override;
     std::shared_ptr<table_iterator> load();
+    void prune_rows(std::vector<zone_predicate>& predicates) override;
     void reset();
+
+    // Persistent index on column, if we iterate over the whole table.
+    index_t* find_index(unsigned int column);
+
+    private:
+    void skip_blocks();
+    void seek_index_rows();
 };
 
 struct view_factory
@@ -88,7 +115,7 @@ struct view_factory
     std::shared_ptr<table_view> view;
 
     view_factory() = default;
-    view_factory(parse_tree_node& node, table_map_t& tables);
+    view_factory(plan_node& node, table_map_t& tables);
 };
 
 #endif
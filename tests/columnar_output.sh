@@ -0,0 +1,20 @@
+# Results written as an Arrow IPC stream and as raw columns,
+# read back by read_columns.py, are the csv --execute writes.
+# The cross join's 100000 rows take two batches of each.
+load="load trades.csv as b, trades.csv as c, trades.csv as d, trades.csv as e;"
+for query in "select TIME, PRICE, QUANTITY, PRICE / 4.0 as quarter from trades;" \
+             "select trades.TIME, b.PRICE, c.QUANTITY * e.TIME from trades cross_join b cross_join c cross_join d cross_join e;"; do
+    ../main trades=trades.csv --execute "$load $query" 2>/dev/null > columnar_output.csv
+    for format in arrow raw; do
+        ../main --output $format trades=trades.csv --execute "$load $query" 2>/dev/null |
+            python3 read_columns.py > columnar_output.$format.csv
+        if cmp -s columnar_output.csv columnar_output.$format.csv; then
+            echo "$format: $(($(wc -l < columnar_output.csv) - 1)) rows match"
+        else
+            echo "$format: differs"
+            diff columnar_output.csv columnar_output.$format.csv | head -5
+        fi
+    done
+done
+head -4 columnar_output.csv
+rm -f columnar_output.csv columnar_output.arrow.csv columnar_output.raw.csv
@@ -0,0 +1,8 @@
+create_table expensive as select TIME, PRICE from trades where PRICE > 100;
+select * from expensive;
+select TIME, PRICE * QUANTITY as notional from trades where QUANTITY >= 20 into big_fills;
+select * from big_fills;
+select max(notional), sum(notional) from big_fills;
+select expensive.TIME, expensive.PRICE, big_fills.notional from expensive inner_join big_fills on expensive.TIME = big_fills.TIME;
+create_table expensive as select * from trades;
+describe expensive;
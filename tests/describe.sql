@@ -0,0 +1,5 @@
+describe trades;
+explain select TIME from trades where PRICE > 104;
+describe trades;
+analyze trades;
+describe trades;
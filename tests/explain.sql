@@ -0,0 +1,5 @@
+explain select TIME from trades where PRICE > 105;
+explain select TIME, PRICE * QUANTITY as notional from trades where TIME >= 1000 limit 3 offset 1;
+explain select max(PRICE), sum(QUANTITY) from trades where QUANTITY > 5;
+explain select time_bucket(TIME, 1000) as bar, last(PRICE) as close from trades;
+explain select TIME, average(PRICE) over (rows 3) from trades;
@@ -0,0 +1,3 @@
+select (0.0 - 1.0) * 0.0 as negative_zero, 0.1 + 0.2 as tenths, 0.0000001 as small, 1.0 / 10000000.0 as divided, 1000000000000000000000.0 as big, 1.7976931348623157e308 as largest from trades limit 1;
+select 100.0 as whole, 0.5 as half, 123456789012345678.0 as long, 1.0 / 3.0 as third, 2.0 / 3.0 as two_thirds from trades limit 1;
+select TIME, PRICE / 3.0 as third, PRICE * 1000000000000000000000.0 as scaled from trades limit 4;
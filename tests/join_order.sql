@@ -0,0 +1,7 @@
+load quotes.csv as quotes, fills.csv as fills;
+explain select * from trades inner_join quotes on trades.TIME = quotes.TIME inner_join fills on quotes.TIME = fills.TIME;
+select * from trades inner_join quotes on trades.TIME = quotes.TIME inner_join fills on quotes.TIME = fills.TIME;
+explain select * from fills inner_join quotes on fills.TIME = quotes.TIME inner_join trades on quotes.TIME = trades.TIME;
+select * from fills inner_join quotes on fills.TIME = quotes.TIME inner_join trades on quotes.TIME = trades.TIME;
+select trades.TIME, trades.PRICE, quotes.BID, fills.SIZE from trades inner_join quotes on trades.TIME = quotes.TIME inner_join fills on quotes.TIME = fills.TIME where trades.PRICE > 100;
+select trades.TIME, trades.PRICE, quotes.BID, fills.SIZE from fills inner_join quotes on fills.TIME = quotes.TIME inner_join trades on quotes.TIME = trades.TIME where trades.PRICE > 100;
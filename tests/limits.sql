@@ -0,0 +1,11 @@
+load trades.csv as b, trades.csv as c, trades.csv as d, trades.csv as e, trades.csv as f, trades.csv as g;
+set statement_timeout = 50;
+select sum(trades.PRICE) from trades cross_join b cross_join c cross_join d cross_join e cross_join f cross_join g;
+select sum(trades.PRICE) from trades cross_join b;
+set statement_timeout = 0;
+set memory_limit = 1000;
+select median(PRICE) from trades;
+create_table copy as select * from trades cross_join b;
+set memory_limit = 0;
+select median(PRICE) from trades;
+describe copy;
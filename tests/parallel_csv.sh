@@ -0,0 +1,13 @@
+# Results of more than one batch of csv_batch_rows are formatted in
+# parallel, and must come out as they do formatted on one thread.
+load="load trades.csv as b, trades.csv as c, trades.csv as d, trades.csv as e;"
+query="select trades.TIME, b.PRICE / 3.0, c.QUANTITY * e.TIME, d.PRICE * e.PRICE, trades.PRICE, b.TIME, c.PRICE / 7.0, d.QUANTITY from trades cross_join b cross_join c cross_join d cross_join e;"
+../main --threads 1 trades=trades.csv --execute "$load $query" 2>/dev/null > parallel_csv.serial.csv
+../main --threads 4 trades=trades.csv --execute "$load $query" 2>/dev/null > parallel_csv.parallel.csv
+if cmp -s parallel_csv.serial.csv parallel_csv.parallel.csv; then
+    echo "$(($(wc -l < parallel_csv.serial.csv) - 1)) rows match"
+else
+    echo "differs"
+fi
+sed -n '1p;2p;8193p;8194p;$p' parallel_csv.parallel.csv
+rm -f parallel_csv.serial.csv parallel_csv.parallel.csv
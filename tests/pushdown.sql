@@ -0,0 +1,15 @@
+load quotes.csv as quotes;
+explain select * from trades inner_join quotes on trades.TIME = quotes.TIME where trades.PRICE > 100 and quotes.BID < 104;
+select * from trades inner_join quotes on trades.TIME = quotes.TIME where trades.PRICE > 100 and quotes.BID < 104;
+explain select * from trades left_join quotes on trades.TIME = quotes.TIME where trades.PRICE > 100 and quotes.BID < 104;
+select * from trades left_join quotes on trades.TIME = quotes.TIME where trades.PRICE > 100 and quotes.BID < 104;
+explain select * from trades right_join quotes on trades.TIME = quotes.TIME where trades.PRICE > 100 and quotes.BID < 104;
+select * from trades right_join quotes on trades.TIME = quotes.TIME where trades.PRICE > 100 and quotes.BID < 104;
+explain select * from trades outer_join quotes on trades.TIME = quotes.TIME where trades.PRICE > 100 and quotes.BID < 104;
+select * from trades outer_join quotes on trades.TIME = quotes.TIME where trades.PRICE > 100 and quotes.BID < 104;
+explain select TIME, PRICE from (select * from trades) where PRICE > 100;
+explain select TIME, PRICE from (select * from trades limit 8) where PRICE > 100;
+select TIME, PRICE from (select * from trades limit 8) where PRICE > 100;
+create_index quotes_time on quotes.TIME;
+explain select * from trades inner_join quotes on trades.TIME = quotes.TIME where trades.PRICE > 100 and quotes.BID < 104;
+select * from trades inner_join quotes on trades.TIME = quotes.TIME where trades.PRICE > 100 and quotes.BID < 104;
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+# Reads an Arrow IPC stream or a raw column stream (see readme.txt) from
+# stdin and prints it as csv, so results written with --output arrow or
+# raw can be compared with --execute's. Doubles are printed by their
+# shortest repr, which is what the engine prints outside of exponents.
+# Reads the Arrow messages from their FlatBuffers tables by the spec,
+# with only the standard library, so it knows nothing of how we lay
+# them out. Only 64 bit integers and doubles without nulls.
+import struct
+import sys
+
+
+def format_cell(value):
+    if isinstance(value, int):
+        return str(value)
+    text = repr(value)
+    return text[:-2] if text.endswith(".0") else text
+
+
+class Table:
+    def __init__(self, buf, pos):
+        self.buf = buf
+        self.pos = pos
+        self.vtable = pos - struct.unpack_from("<i", buf, pos)[0]
+        self.vtable_size = struct.unpack_from("<H", buf, self.vtable)[0]
+
+    def offset(self, field):
+        at = 4 + 2 * field
+        if at >= self.vtable_size:
+            return 0
+        return struct.unpack_from("<H", self.buf, self.vtable + at)[0]
+
+    def scalar(self, field, fmt, default=0):
+        offset = self.offset(field)
+        if not offset:
+            return default
+        return struct.unpack_from("<" + fmt, self.buf, self.pos + offset)[0]
+
+    def indirect(self, field):
+        at = self.pos + self.offset(field)
+        return at + struct.unpack_from("<I", self.buf, at)[0]
+
+    def table(self, field):
+        return Table(self.buf, self.indirect(field))
+
+    def string(self, field):
+        at = self.indirect(field)
+        length = struct.unpack_from("<I", self.buf, at)[0]
+        return self.buf[at + 4:at + 4 + length].decode()
+
+    def vector(self, field):
+        at = self.indirect(field)
+        return at + 4, struct.unpack_from("<I", self.buf, at)[0]
+
+    def tables(self, field):
+        start, count = self.vector(field)
+        return [Table(self.buf, start + 4 * i + struct.unpack_from("<I", self.buf, start + 4 * i)[0])
+                for i in range(count)]
+
+    def structs(self, field, fmt):
+        start, count = self.vector(field)
+        size = struct.calcsize("<" + fmt)
+        return [struct.unpack_from("<" + fmt, self.buf, start + size * i) for i in range(count)]
+
+
+HEADER_SCHEMA, HEADER_RECORD_BATCH = 1, 3
+TYPE_INT, TYPE_FLOATING_POINT = 2, 3
+PRECISION_DOUBLE = 2
+
+
+def read_exactly(stream, length):
+    data = stream.read(length)
+    if len(data) != length:
+        sys.exit("Stream ended early.")
+    return data
+
+
+def read_arrow(stream, out):
+    formats = None
+    while True:
+        marker, length = struct.unpack("<Ii", read_exactly(stream, 8))
+        if marker != 0xFFFFFFFF:
+            sys.exit("Expected a continuation marker.")
+        if length == 0:
+            return
+
+        metadata = read_exactly(stream, length)
+        message = Table(metadata, struct.unpack_from("<I", metadata, 0)[0])
+        header_type = message.scalar(1, "B")
+        header = message.table(2)
+        body = read_exactly(stream, message.scalar(3, "q"))
+
+        if header_type == HEADER_SCHEMA:
+            formats, names = [], []
+            for field in header.tables(1):
+                type_type, kind = field.scalar(2, "B"), field.table(3)
+                if type_type == TYPE_INT and kind.scalar(0, "i") == 64 and kind.scalar(1, "B"):
+                    formats.append("q")
+                elif type_type == TYPE_FLOATING_POINT and kind.scalar(0, "h") == PRECISION_DOUBLE:
+                    formats.append("d")
+                else:
+                    sys.exit("Unsupported column type.")
+                names.append(field.string(0))
+            out.write(",".join(names) + "\n")
+        elif header_type == HEADER_RECORD_BATCH:
+            rows = header.scalar(0, "q")
+            buffers = header.structs(2, "qq")
+            columns = []
+            for i, fmt in enumerate(formats):
+                validity, values = buffers[2 * i], buffers[2 * i + 1]
+                if validity[1]:
+                    sys.exit("Unexpected nulls.")
+                columns.append(struct.unpack_from("<%d%s" % (rows, fmt), body, values[0]))
+            for row in zip(*columns):
+                out.write(",".join(format_cell(value) for value in row) + "\n")
+        else:
+            sys.exit("Unexpected message type %d." % header_type)
+
+
+def read_raw(stream, out):
+    width = struct.unpack("<I", read_exactly(stream, 4))[0]
+    formats, names = [], []
+    for _ in range(width):
+        kind, length = struct.unpack("<BI", read_exactly(stream, 5))
+        formats.append("q" if kind == 0 else "d")
+        names.append(read_exactly(stream, length).decode())
+    out.write(",".join(names) + "\n")
+
+    while True:
+        rows = struct.unpack("<Q", read_exactly(stream, 8))[0]
+        if not rows:
+            return
+        columns = [struct.unpack("<%d%s" % (rows, fmt), read_exactly(stream, 8 * rows))
+                   for fmt in formats]
+        for row in zip(*columns):
+            out.write(",".join(format_cell(value) for value in row) + "\n")
+
+
+def main():
+    stream = sys.stdin.buffer
+    magic = read_exactly(stream, 8)
+    if magic == b"CSQLCOL1":
+        read_raw(stream, sys.stdout)
+        return
+
+    # The first message's marker and length, read again.
+    stream = Prefixed(magic, stream)
+    read_arrow(stream, sys.stdout)
+
+
+class Prefixed:
+    def __init__(self, prefix, stream):
+        self.prefix = prefix
+        self.stream = stream
+
+    def read(self, length):
+        data, self.prefix = self.prefix[:length], self.prefix[length:]
+        return data + self.stream.read(length - len(data))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,22 @@
+#!/bin/sh
+# Runs the statements of each tests/*.sql against trades.csv, and each
+# other tests/*.sh script, comparing what's printed with the .expected
+# file of the same name.
+cd "$(dirname "$0")"
+failed=0
+for test in *.sql *.sh; do
+    name=${test%.*}
+    case $test in
+        run.sh) continue ;;
+        *.sql)  ../main trades=trades.csv --execute "$(cat "$test")" 2>&1 |
+                    grep -v "^Executed command" > "$name.out" ;;
+        *.sh)   sh "$test" > "$name.out" 2>&1 ;;
+    esac
+    if diff -u "$name.expected" "$name.out"; then
+        rm "$name.out"
+    else
+        echo "FAILED: $name"
+        failed=1
+    fi
+done
+exit $failed
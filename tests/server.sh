@@ -0,0 +1,19 @@
+# Queries over --connect get the output --execute writes, and later
+# connections see tables created by earlier ones. A failed query only
+# fails it's own connection.
+sock=server_test.sock
+rm -f $sock
+../main --serve $sock trades=trades.csv 2>/dev/null &
+server=$!
+tries=0
+while [ ! -S $sock ] && [ $tries -lt 100 ]; do sleep 0.1; tries=$((tries + 1)); done
+
+../main --connect $sock --execute "select TIME, PRICE from trades where QUANTITY > 20;" 2>&1 | grep -v "^Executed command"
+../main --connect $sock --execute "select * from missing;" 2>&1 | grep -v "^Executed command"
+../main --connect $sock --execute "create_table big as select TIME, PRICE from trades where PRICE > 104;" 2>&1 | grep -v "^Executed command"
+../main --connect $sock --execute "select * from big;" 2>&1 | grep -v "^Executed command"
+../main --output arrow --connect $sock --execute "select TIME, PRICE from big;" 2>/dev/null | python3 read_columns.py
+
+kill $server
+wait $server 2>/dev/null
+rm -f $sock
@@ -0,0 +1,4 @@
+select time_bucket(TIME, 1000) as bar, max(PRICE) as high, sum(QUANTITY) as volume from trades limit 2;
+select time_bucket(TIME, 1000) as bar, max(PRICE) as high, sum(QUANTITY) as volume from trades limit 2 offset 1;
+select time_bucket(TIME, 1000) as bar, min(PRICE) as low from trades where QUANTITY > 5 limit 10 offset 3;
+select time_bucket(TIME, 1000) as bar, min(PRICE) as low from trades limit 3 offset 5;
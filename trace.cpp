@@ -0,0 +1,75 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.hpp"
+
+bool tracing = false;
+
+struct trace_event
+{
+    std::string  name;
+    double       begin, duration;
+    unsigned int thread;
+};
+
+static std::string              trace_file;
+static trace_time               trace_start;
+static std::vector<trace_event> events;
+static std::mutex               events_mutex;
+
+// Threads are numbered in the order they first record a span.
+static std::unordered_map<std::thread::id, unsigned int> threads;
+
+static double microseconds(trace_time from, trace_time to)
+{
+    return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+static void write_trace()
+{
+    FILE* fd = fopen(trace_file.c_str(), "w");
+    if(fd == NULL)
+    {
+        std::cerr << "Error writing trace: " << trace_file << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(events_mutex);
+    fprintf(fd, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fd, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"args\":{\"name\":\"csvsql\"}}");
+    for(unsigned int i = 1; i <= threads.size(); i++)
+        fprintf(fd, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                    "\"args\":{\"name\":\"%s %u\"}}", i, i == 1 ? "main" : "worker", i);
+    for(auto& event : events)
+        fprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"csvsql\",\"ph\":\"X\",\"pid\":1,"
+                    "\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                event.name.c_str(), event.thread, event.begin, event.duration);
+    fprintf(fd, "\n]}\n");
+    fclose(fd);
+}
+
+void start_trace(const std::string& file_name)
+{
+    if(!tracing)
+        atexit(write_trace);
+
+    tracing     = true;
+    trace_file  = file_name;
+    trace_start = std::chrono::steady_clock::now();
+}
+
+void record_span(const std::string& name, trace_time start)
+{
+    auto end = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(events_mutex);
+    auto thread = threads.emplace(std::this_thread::get_id(), threads.size() + 1).first;
+    events.push_back(trace_event{name, microseconds(trace_start, start),
+                                 microseconds(start, end), thread->second});
+}
@@ -0,0 +1,40 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <chrono>
+#include <string>
+
+// Spans of where time goes, recorded when run with --trace file.json.
+// They're written on exit in the Chrome trace event format, to be
+// opened in chrome://tracing or Perfetto. Nested spans on the same
+// thread show as a stack.
+
+typedef std::chrono::steady_clock::time_point trace_time;
+
+extern bool tracing;
+
+void start_trace(const std::string& file_name);
+
+// Records a span from start until now.
+void record_span(const std::string& name, trace_time start);
+
+// Records a span for as long as it's in scope.
+struct trace_span
+{
+    const char* name;
+    trace_time  start;
+
+    trace_span(const char* name_) : name(name_)
+    {
+        if(tracing)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~trace_span()
+    {
+        if(tracing)
+            record_span(name, start);
+    }
+};
+
+#endif